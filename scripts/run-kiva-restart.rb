@@ -0,0 +1,76 @@
+require('open3')
+require('fileutils')
+require('date')
+
+# Simulates a case in one run and again in two runs, checkpointing at
+# RESTART_DATE and restarting from the checkpoint. The output of the two
+# runs (combined) must match the output of the single run. An optional
+# reporting interval (e.g., DAILY) aggregates the output report, checking
+# that an interval is not written by both runs.
+
+puts("Running Kiva restart test")
+
+RESTART_DATE = "2015-Jul-1"
+
+KIVA_PATH = File.expand_path(ARGV[0])
+INPUT_FILE = File.expand_path(ARGV[1])
+WEATHER_FILE = File.expand_path(ARGV[2])
+OUTPUT_DIR = File.expand_path(ARGV[3])
+REPORTING_INTERVAL = ARGV[4]
+
+def run(*args)
+  cmd = [KIVA_PATH] + args
+  puts("  ... cmd = #{cmd.join(' ')}")
+  stdout, stderr, status = Open3.capture3(*cmd)
+  unless status.success?
+    puts(stdout)
+    puts(stderr)
+    puts("Kiva failed (#{status})")
+    exit(1)
+  end
+end
+
+FileUtils.rm_rf(OUTPUT_DIR) if File.exist?(OUTPUT_DIR)
+FileUtils.mkdir_p(OUTPUT_DIR)
+
+input = File.read(INPUT_FILE)
+if REPORTING_INTERVAL
+  input = input.sub(/^(\s*)Output Report:\n/) { "#{$&}#{$1}  Reporting Interval: #{REPORTING_INTERVAL}\n" }
+end
+full_input = File.join(OUTPUT_DIR, "full.yaml")
+File.write(full_input, input)
+
+# The first run ends the day before the restart date
+first_end = (Date.parse(RESTART_DATE) - 1).strftime("%Y-%b-%-d")
+first_input = File.join(OUTPUT_DIR, "first.yaml")
+File.write(first_input, input.sub(/End Date:.*$/, "End Date: #{first_end}"))
+
+full_output = File.join(OUTPUT_DIR, "full.csv")
+first_output = File.join(OUTPUT_DIR, "first.csv")
+second_output = File.join(OUTPUT_DIR, "second.csv")
+checkpoint = File.join(OUTPUT_DIR, "restart.chk")
+
+run(full_input, WEATHER_FILE, full_output)
+run("--checkpoint", checkpoint, first_input, WEATHER_FILE, first_output)
+run("--restart", checkpoint, full_input, WEATHER_FILE, second_output)
+
+full = File.readlines(full_output)
+first = File.readlines(first_output)
+second = File.readlines(second_output)
+
+if first.length < 2 || second.length < 2
+  puts("Split runs wrote no results")
+  exit(1)
+end
+
+combined = first + second.drop(1)  # second run repeats the header
+if combined != full
+  mismatch = (0...[combined.length, full.length].max).find { |i| combined[i] != full[i] }
+  puts("Restarted output differs from the single run at line #{mismatch + 1}:")
+  puts("  single run: #{full[mismatch]}")
+  puts("  restarted:  #{combined[mismatch]}")
+  exit(1)
+end
+
+puts("Restarted output matches the single run (#{full.length - 1} rows)")
+exit(0)
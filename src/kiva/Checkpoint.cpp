@@ -0,0 +1,286 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef Checkpoint_CPP
+#define Checkpoint_CPP
+
+#include "Checkpoint.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include <boost/filesystem.hpp>
+
+static const char header[] = "KIVACHK1";
+static const char trailer[] = "KCHKEND1";
+static const unsigned int byteOrder = 0x01020304;
+static const long long noTime = std::numeric_limits<long long>::min();
+static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+const unsigned int Checkpoint::version;
+
+Checkpoint::Checkpoint() :
+  required(true),
+  failed(false)
+{
+}
+
+bool Checkpoint::create(std::string fileName, bool required)
+{
+  this->fileName = fileName;
+  this->required = required;
+  failed = false;
+
+  // Uniquely named so that concurrent runs never write the same file
+  boost::system::error_code error;
+  temporaryFileName = fileName + "." +
+      boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%", error).string() + ".tmp";
+
+  output.open(temporaryFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+  write(header, 8);
+  write((const char*)&version, sizeof(version));
+  write((const char*)&byteOrder, sizeof(byteOrder));
+
+  return !failed;
+}
+
+void Checkpoint::write(const char* data, std::size_t size)
+{
+  if (failed)
+    return;
+
+  output.write(data, size);
+  if (!output)
+    fail();
+}
+
+void Checkpoint::fail()
+{
+  if (required)
+  {
+    std::cerr << "Error: Unable to write checkpoint file \"" << temporaryFileName << "\"." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  failed = true;
+}
+
+void Checkpoint::writeSize(std::size_t value)
+{
+  unsigned long long size = value;
+  write((const char*)&size, sizeof(size));
+}
+
+void Checkpoint::writeLong(long value)
+{
+  long long number = value;
+  write((const char*)&number, sizeof(number));
+}
+
+void Checkpoint::writeDouble(double value)
+{
+  write((const char*)&value, sizeof(value));
+}
+
+void Checkpoint::writeTime(boost::posix_time::ptime value)
+{
+  long long seconds = value.is_special() ? noTime : (long long)(value - epoch).total_seconds();
+  write((const char*)&seconds, sizeof(seconds));
+}
+
+void Checkpoint::writeArray(const std::vector<double> &values)
+{
+  writeSize(values.size());
+  write((const char*)values.data(), values.size()*sizeof(double));
+}
+
+void Checkpoint::writeString(const std::string &value)
+{
+  writeSize(value.size());
+  write(value.data(), value.size());
+}
+
+bool Checkpoint::commit()
+{
+  write(trailer, 8);
+  output.close();
+  if (!output && !failed)
+    fail();
+
+  boost::system::error_code error;
+  if (!failed)
+    boost::filesystem::rename(temporaryFileName, fileName, error);
+
+  if (failed || error)
+  {
+    if (required)
+    {
+      std::cerr << "Error: Unable to replace checkpoint file \"" << fileName << "\": " << error.message() << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    boost::filesystem::remove(temporaryFileName, error);
+    return false;
+  }
+  return true;
+}
+
+bool Checkpoint::open(std::string fileName, bool required)
+{
+  this->fileName = fileName;
+
+  input.open(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!input && !required)
+    return false;
+  if (!input)
+  {
+    std::cerr << "Error: Unable to open checkpoint file \"" << fileName << "\"." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  char fileHeader[8];
+  unsigned int fileVersion, fileByteOrder;
+  read(fileHeader, 8);
+  read((char*)&fileVersion, sizeof(fileVersion));
+  read((char*)&fileByteOrder, sizeof(fileByteOrder));
+
+  if (std::string(fileHeader, 8) != std::string(header, 8) || fileByteOrder != byteOrder)
+  {
+    std::cerr << "Error: \"" << fileName << "\" is not a checkpoint file written on this platform." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (fileVersion != version)
+  {
+    std::cerr << "Error: Checkpoint file \"" << fileName << "\" has version " << fileVersion
+              << ", but this version of Kiva reads version " << version << "." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return true;
+}
+
+void Checkpoint::read(char* data, std::size_t size)
+{
+  input.read(data, size);
+  if (!input)
+  {
+    std::cerr << "Error: Checkpoint file \"" << fileName << "\" is incomplete." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void Checkpoint::skip(std::size_t size)
+{
+  input.seekg(size, std::ios::cur);
+  if (!input)
+  {
+    std::cerr << "Error: Checkpoint file \"" << fileName << "\" is incomplete." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+std::size_t Checkpoint::readSize()
+{
+  unsigned long long size;
+  read((char*)&size, sizeof(size));
+  return std::size_t(size);
+}
+
+long Checkpoint::readLong()
+{
+  long long number;
+  read((char*)&number, sizeof(number));
+  return long(number);
+}
+
+double Checkpoint::readDouble()
+{
+  double value;
+  read((char*)&value, sizeof(value));
+  return value;
+}
+
+boost::posix_time::ptime Checkpoint::readTime()
+{
+  long long seconds;
+  read((char*)&seconds, sizeof(seconds));
+  if (seconds == noTime)
+    return boost::posix_time::ptime();
+  return epoch + boost::posix_time::seconds(long(seconds));
+}
+
+std::vector<double> Checkpoint::readArray()
+{
+  std::vector<double> values(readSize());
+  read((char*)values.data(), values.size()*sizeof(double));
+  return values;
+}
+
+std::size_t Checkpoint::readArray(std::vector<double> &values, std::size_t begin, std::size_t count)
+{
+  std::size_t length = readSize();
+  if (begin + count > length)
+  {
+    values.clear();
+    skip(length*sizeof(double));
+    return length;
+  }
+
+  values.resize(count);
+  skip(begin*sizeof(double));
+  read((char*)values.data(), count*sizeof(double));
+  skip((length - begin - count)*sizeof(double));
+  return length;
+}
+
+std::string Checkpoint::readString()
+{
+  std::string value(readSize(), '\0');
+  if (!value.empty())
+    read(&value[0], value.size());
+  return value;
+}
+
+void Checkpoint::checkSize(std::size_t expected, std::string description)
+{
+  std::size_t size = readSize();
+  if (size != expected)
+  {
+    std::cerr << "Error: Checkpoint file \"" << fileName << "\" has " << size << " " << description
+              << ", but the input has " << expected << "." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void Checkpoint::close()
+{
+  char fileTrailer[8];
+  read(fileTrailer, 8);
+  if (std::string(fileTrailer, 8) != std::string(trailer, 8))
+  {
+    std::cerr << "Error: Checkpoint file \"" << fileName << "\" does not match the input." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  input.close();
+}
+
+bool Checkpoint::isComplete(std::string fileName)
+{
+  std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+    return false;
+
+  char fileHeader[8], fileTrailer[8];
+  unsigned int fileVersion, fileByteOrder;
+  file.read(fileHeader, 8);
+  file.read((char*)&fileVersion, sizeof(fileVersion));
+  file.read((char*)&fileByteOrder, sizeof(fileByteOrder));
+  file.seekg(-8, std::ios::end);
+  file.read(fileTrailer, 8);
+
+  return file && std::string(fileHeader, 8) == std::string(header, 8) &&
+      fileVersion == version && fileByteOrder == byteOrder &&
+      std::string(fileTrailer, 8) == std::string(trailer, 8);
+}
+
+#endif
@@ -0,0 +1,87 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/gregorian/gregorian.hpp>
+
+// Versioned binary file holding the state of a simulation from which a later
+// run can resume. Values are written in sequence by the objects that own the
+// state, and read back in the same order:
+//
+//   "KIVACHK1", uint32 version, uint32 byte order mark (0x01020304),
+//   values (uint64 sizes and counts, int64 times [s since 1970-01-01
+//   00:00:00, or the minimum value for no time], float64 values, arrays as a
+//   uint64 length followed by the elements, and strings likewise), "KCHKEND1"
+//
+// All values are in native byte order. A checkpoint is written to a
+// temporary file that replaces the named file only once it is complete, so
+// an interrupted run leaves the previous checkpoint intact.
+class Checkpoint
+{
+public:
+
+  Checkpoint();
+
+  static const unsigned int version = 2;
+
+  // Writing (errors stop the program if the checkpoint is required;
+  // otherwise, create and commit return false and nothing is written)
+  bool create(std::string fileName, bool required = true);
+  void writeSize(std::size_t value);
+  void writeLong(long value);
+  void writeDouble(double value);
+  void writeTime(boost::posix_time::ptime value);
+  void writeArray(const std::vector<double> &values);
+  void writeString(const std::string &value);
+  bool commit();
+
+  // Reading (errors if the file is truncated or was not written by this
+  // version). If the checkpoint is not required, open returns false instead
+  // of stopping the program when the file cannot be opened.
+  bool open(std::string fileName, bool required = true);
+  std::size_t readSize();
+  long readLong();
+  double readDouble();
+  boost::posix_time::ptime readTime();
+  std::vector<double> readArray();
+
+  // Reads the elements [begin, begin + count) of an array (e.g., the columns
+  // of a domain stored by one process), skipping the others, and returns
+  // the length of the whole array. If the array is shorter, values is left
+  // empty.
+  std::size_t readArray(std::vector<double> &values, std::size_t begin, std::size_t count);
+  std::string readString();
+  void close();
+
+  // True if the file is a complete checkpoint written by this version on
+  // this platform
+  static bool isComplete(std::string fileName);
+
+  // Reads a size and errors unless it is the expected value (e.g., the
+  // dimensions of the domain)
+  void checkSize(std::size_t expected, std::string description);
+
+private:
+
+  std::string fileName;
+  std::string temporaryFileName;
+  std::ofstream output;
+  bool required;
+  bool failed;
+  std::ifstream input;
+
+  void read(char* data, std::size_t size);
+  void skip(std::size_t size);
+  void write(const char* data, std::size_t size);
+  void fail();
+
+};
+
+#endif /* CHECKPOINT_H_ */
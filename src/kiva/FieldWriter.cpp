@@ -0,0 +1,175 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef FieldWriter_CPP
+#define FieldWriter_CPP
+
+#include "FieldWriter.hpp"
+#include "Tracer.hpp"
+
+#include <cmath>
+
+#include <zlib.h>
+
+static const long maxQuantizedValue = 1L << 30;  // keeps changes within int32
+
+FieldWriter::FieldWriter(OutputField &outputField, Domain &domain) :
+  outputField(outputField),
+  opened(false),
+  frameCount(0)
+{
+  getRange(domain.meshX, outputField.xRangeSet, outputField.xRange, iMin, iMax);
+  getRange(domain.meshY, outputField.yRangeSet, outputField.yRange, jMin, jMax);
+  getRange(domain.meshZ, outputField.zRangeSet, outputField.zRange, kMin, kMax);
+
+  std::size_t nI = iMax - iMin + 1;
+  std::size_t nJ = jMax - jMin + 1;
+  std::size_t nK = kMax - kMin + 1;
+  nCells = nI*nJ*nK;
+}
+
+FieldWriter::~FieldWriter()
+{
+  close();
+}
+
+void FieldWriter::open(Domain &domain)
+{
+  std::size_t nI = iMax - iMin + 1;
+  std::size_t nJ = jMax - jMin + 1;
+  std::size_t nK = kMax - kMin + 1;
+
+  file.open(outputField.fileName.c_str(), std::ios::out | std::ios::binary);
+  if (!file)
+  {
+    std::cerr << "Error: Unable to create output field file \"" << outputField.fileName << "\"." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  opened = true;
+
+  const unsigned int version = 1;
+  const unsigned int byteOrder = 0x01020304;
+  unsigned long long dimensions[3] = {nI, nJ, nK};
+  unsigned long long keyframeInterval = outputField.keyframeInterval;
+
+  file.write("KIVAFLD1", 8);
+  file.write((const char*)&version, sizeof(version));
+  file.write((const char*)&byteOrder, sizeof(byteOrder));
+  file.write((const char*)dimensions, sizeof(dimensions));
+  file.write((const char*)&outputField.precision, sizeof(double));
+  file.write((const char*)&keyframeInterval, sizeof(keyframeInterval));
+  file.write((const char*)&domain.meshX.centers[iMin], nI*sizeof(double));
+  file.write((const char*)&domain.meshY.centers[jMin], nJ*sizeof(double));
+  file.write((const char*)&domain.meshZ.centers[kMin], nK*sizeof(double));
+
+  previous.resize(nCells);
+  planes.resize(4*nCells);
+  compressed.resize(compressBound(uLong(planes.size())));
+}
+
+void FieldWriter::getRange(Mesher &mesh, bool rangeSet, std::pair<double, double> range,
+                           std::size_t &nMin, std::size_t &nMax)
+{
+  nMin = 0;
+  nMax = mesh.centers.size() - 1;
+
+  if (!rangeSet)
+    return;
+
+  // Cells with centers within the range
+  while (nMin < mesh.centers.size() && mesh.centers[nMin] < range.first)
+    nMin++;
+  while (nMax > 0 && mesh.centers[nMax] > range.second)
+    nMax--;
+
+  if (nMin >= mesh.centers.size() || mesh.centers[nMax] > range.second || nMin > nMax)
+  {
+    // Range falls between cell centers: use the nearest cell
+    nMin = nMax = mesh.getNearestIndex(0.5*(range.first + range.second));
+  }
+}
+
+bool FieldWriter::makeNewFrame(boost::posix_time::ptime t)
+{
+  return (t >= nextFrameTime) && (t >= tStart) && (t <= tEnd);
+}
+
+void FieldWriter::beginFrame()
+{
+  nextFrameTime += outputField.frequency;
+}
+
+void FieldWriter::writeFrame(boost::posix_time::ptime t, const std::vector<double> &values)
+{
+  Kiva::Tracer::Scope trace("Write field");
+  bool keyframe = frameCount % outputField.keyframeInterval == 0;
+
+  for (std::size_t n = 0; n < nCells; n++)
+  {
+    double q = std::floor(values[n]/outputField.precision + 0.5);
+    if (!(std::fabs(q) < maxQuantizedValue))
+    {
+      std::cerr << "Error: Temperature " << values[n] << " K cannot be stored in output field \""
+                << outputField.fileName << "\" with a precision of " << outputField.precision << " K." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    long quantized = long(q);
+    int value = int(keyframe ? quantized : quantized - previous[n]);
+    previous[n] = quantized;
+
+    // Shifted as unsigned (left shifts of negative values are undefined)
+    unsigned int zigZag = ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+    planes[n] = (unsigned char)(zigZag);
+    planes[nCells + n] = (unsigned char)(zigZag >> 8);
+    planes[2*nCells + n] = (unsigned char)(zigZag >> 16);
+    planes[3*nCells + n] = (unsigned char)(zigZag >> 24);
+  }
+
+  uLongf compressedSize = uLongf(compressed.size());
+  if (compress2(&compressed[0], &compressedSize, &planes[0], uLong(planes.size()),
+                Z_DEFAULT_COMPRESSION) != Z_OK)
+  {
+    std::cerr << "Error: Unable to compress output field \"" << outputField.fileName << "\"." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+  IndexEntry entry;
+  entry.time = (t - epoch).total_seconds();
+  entry.offset = (unsigned long long)file.tellp();
+  entry.flags = keyframe ? 1 : 0;
+  index.push_back(entry);
+
+  unsigned long long size = compressedSize;
+  file.write((const char*)&entry.time, sizeof(entry.time));
+  file.write((const char*)&entry.flags, sizeof(entry.flags));
+  file.write((const char*)&size, sizeof(size));
+  file.write((const char*)&compressed[0], size);
+
+  frameCount++;
+}
+
+void FieldWriter::close()
+{
+  if (!opened)
+    return;
+
+  unsigned long long indexOffset = (unsigned long long)file.tellp();
+  for (std::size_t f = 0; f < index.size(); f++)
+  {
+    file.write((const char*)&index[f].time, sizeof(index[f].time));
+    file.write((const char*)&index[f].offset, sizeof(index[f].offset));
+    file.write((const char*)&index[f].flags, sizeof(index[f].flags));
+  }
+
+  unsigned long long frames = index.size();
+  file.write((const char*)&frames, sizeof(frames));
+  file.write((const char*)&indexOffset, sizeof(indexOffset));
+  file.write("KFLDIDX1", 8);
+
+  file.close();
+  opened = false;
+}
+
+#endif
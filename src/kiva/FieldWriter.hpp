@@ -0,0 +1,88 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef FIELDWRITER_H_
+#define FIELDWRITER_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/gregorian/gregorian.hpp>
+
+#include "Input.hpp"
+#include "Domain.hpp"
+
+using namespace Kiva;
+
+// Writes the temperatures [K] of a block of cells to a compressed binary
+// file at regular intervals. Temperatures are quantized to the field's
+// precision. Keyframes store the quantized values and the frames between them
+// store the change from the previous frame. Each frame is zig-zag encoded,
+// split into byte planes, and compressed with zlib:
+//
+//   Header: "KIVAFLD1", uint32 version, uint32 byte order mark (0x01020304),
+//     uint64 nI, nJ, nK, float64 precision [K], uint64 keyframe interval,
+//     float64 cell centers x[nI], y[nJ], z[nK] [m]
+//   Frames: int64 time [s since 1970-01-01 00:00:00], uint64 flags (1 for
+//     keyframes), uint64 compressed size, compressed data. Decompressed,
+//     the data is byte b of every value, for b = 0..3, where each value is
+//     the uint32 zig-zag encoding of the quantized temperature (keyframes) or
+//     its change since the last frame, for cells ordered i + nI*(j + nJ*k).
+//   Index: for each frame, int64 time, uint64 file offset, uint64 flags
+//   Trailer: uint64 frames, uint64 index offset, "KFLDIDX1"
+//
+// All values are in native byte order.
+class FieldWriter
+{
+public:
+
+  FieldWriter(OutputField &outputField, Domain &domain);
+  ~FieldWriter();
+
+  std::size_t iMin, iMax, jMin, jMax, kMin, kMax;
+  boost::posix_time::ptime tStart, tEnd;
+  boost::posix_time::ptime nextFrameTime;
+
+  // Creates the file and writes the header
+  void open(Domain &domain);
+
+  bool makeNewFrame(boost::posix_time::ptime t);
+
+  // Advances to the time of the next frame
+  void beginFrame();
+
+  // Writes temperatures of the cells ordered as in the file. Frames must be
+  // written in order, but not necessarily on the thread that created the
+  // writer.
+  void writeFrame(boost::posix_time::ptime t, const std::vector<double> &values);
+
+  void close();
+
+private:
+
+  OutputField outputField;
+  std::ofstream file;
+  bool opened;
+  std::size_t nCells;
+  long long frameCount;
+
+  std::vector<long> previous;  // quantized values of the last frame
+  std::vector<unsigned char> planes;
+  std::vector<unsigned char> compressed;
+
+  struct IndexEntry
+  {
+    long long time;
+    unsigned long long offset;
+    unsigned long long flags;
+  };
+  std::vector<IndexEntry> index;
+
+  static void getRange(Mesher &mesh, bool rangeSet, std::pair<double, double> range,
+                       std::size_t &nMin, std::size_t &nMax);
+
+};
+
+#endif /* FIELDWRITER_H_ */
@@ -5,20 +5,33 @@
 #define GroundPlot_CPP
 
 #include "GroundPlot.hpp"
+#include "Tracer.hpp"
 
 using namespace Kiva;
 
 static const double EPSILON = 1E-5;
 
+// The "heros" font is read from disk once and copied into each frame's graph
+// (loading a font changes the locale, so it is not safe on worker threads)
+static const mglGraph &getFont()
+{
+  struct FontGraph
+  {
+    mglGraph gr;
+    FontGraph() {gr.LoadFont("heros");}
+  };
+  static FontGraph font;
+  return font.gr;
+}
+
 GroundPlot::GroundPlot(OutputAnimation &outputAnimation, Domain &domain, std::vector<Block> &blocks) :
   outputAnimation(outputAnimation), blocks(blocks)
 {
 
-  boost::filesystem::remove_all(outputAnimation.dir);
-  boost::filesystem::create_directory(outputAnimation.dir);
-
   frameNumber = 0;
 
+  getFont();  // load before any frames are rendered by worker threads
+
   if (outputAnimation.outputUnits == OutputAnimation::IP)
     distanceUnitConversion = 3.28084;
   else
@@ -140,15 +153,13 @@ GroundPlot::GroundPlot(OutputAnimation &outputAnimation, Domain &domain, std::ve
     slice = domain.meshZ.centers[kMin];
   }
 
-  mglData TDatRef(hAxis.nN,vAxis.nN),
-      hDatRef(hAxis.nN),
+  mglData hDatRef(hAxis.nN),
       vDatRef(vAxis.nN),
       hGridRef(hAxis.nN + 1),
       vGridRef(vAxis.nN + 1),
       TGridRef(hAxis.nN + 1, vAxis.nN + 1),
       cDatRef(contourLevels);
 
-  TDat = TDatRef;
   hDat = hDatRef;
   vDat = vDatRef;
   hGrid = hGridRef;
@@ -193,154 +204,30 @@ GroundPlot::GroundPlot(OutputAnimation &outputAnimation, Domain &domain, std::ve
   for (size_t n = 0; n < contourLevels; n++)
       cDat.a[n] = min + double(n)*step;
 
-}
-
-void GroundPlot::createFrame(std::string timeStamp)
-{
-
-
-  std::string distanceUnit;
-  std::string temperatureUnit;
-  std::string fluxUnit;
-
-  if (outputAnimation.outputUnits == OutputAnimation::IP)
-  {
-    distanceUnit = "ft";
-    temperatureUnit = "\\textdegree F";
-    fluxUnit = "W/ft^2";
-  }
-  else
-  {
-    distanceUnit = "m";
-    temperatureUnit = "\\textdegree C";
-    fluxUnit = "W/m^2";
-  }
-
-  double hMin = hGrid.a[0];
-  double hMax = hGrid.a[hAxis.nN];
-  double hRange = hMax - hMin;
-
-  double vMin = vGrid.a[0];
-  double vMax = vGrid.a[vAxis.nN];
-  double vRange = vMax - vMin;
-
-  int nT = cDat.GetNN();
-  double Tmin = cDat.a[0];
-  double Tmax = cDat.a[nT - 1];
-  double Tstep = cDat.a[1] - cDat.a[0];
-
-  // Text properties
-  double hText = 0.05;
-  double vText = 0.95;
-
-  double vTextSpacing = 0.05;
-
-  mglGraph gr;
-  gr.LoadFont("heros");
-
-  // Plot
-  gr.Clf(1,1,1);
-  double aspect = 1.0;
-  int height = outputAnimation.size;
-  int width = height*aspect;
-
-
-  gr.SetSize(width,height);
-
-  gr.SetFontSize(2.0);
-  gr.SetRange('x', hGrid);
-  gr.SetRange('y', vGrid);
-  gr.SetRange('c', Tmin, Tmax);
-  gr.SetRange('z', Tmin, Tmax);
-  gr.SetTicks('c', Tstep, nT, Tmin);
-  gr.Aspect(hRange, vRange);
-
-
-  // Timestamp
+  // Static parts of every frame
+  hMin = hGrid.a[0];
+  hMax = hGrid.a[hAxis.nN];
 
-  std::string timeStampMinusYear = timeStamp.substr(5,timeStamp.size()-5);
-  if (outputAnimation.axes)
-  {
-    if (outputAnimation.colorScheme != OutputAnimation::C_NONE)
-    {
-      if  (outputAnimation.plotType == OutputAnimation::P_TEMP)
-        gr.Puts(0.9, 0.056, temperatureUnit.c_str(), ":AL");
-      else
-        gr.Puts(0.9, 0.056, fluxUnit.c_str(), ":AL");
-    }
-  }
+  vMin = vGrid.a[0];
+  vMax = vGrid.a[vAxis.nN];
 
-  if (outputAnimation.timestamp)
-    gr.Puts(hText, vText, timeStampMinusYear.c_str(), ":AL");
+  std::string distanceUnit = outputAnimation.outputUnits == OutputAnimation::IP ? "ft" : "m";
 
   switch (sliceType)
   {
   case XZ_2D:
-  {
-  }
   break;
   case XY:
-  {
-    std::string sliceString = "Z = " + str(boost::format("%0.2f") % (slice*distanceUnitConversion)) + " " + distanceUnit;
-    if (outputAnimation.axes)
-      gr.Puts(hText, vText - vTextSpacing, sliceString.c_str(), ":AL");
-  }
+    sliceLabel = "Z = " + str(boost::format("%0.2f") % (slice*distanceUnitConversion)) + " " + distanceUnit;
   break;
   case XZ:
-  {
-    std::string sliceString = "Y = " + str(boost::format("%0.2f") % (slice*distanceUnitConversion)) + " " + distanceUnit;
-    if (outputAnimation.axes)
-      gr.Puts(hText, vText - vTextSpacing, sliceString.c_str(), ":AL");
-  }
+    sliceLabel = "Y = " + str(boost::format("%0.2f") % (slice*distanceUnitConversion)) + " " + distanceUnit;
   break;
   case YZ:
-  {
-    std::string sliceString = "X = " + str(boost::format("%0.2f") % (slice*distanceUnitConversion)) + " " + distanceUnit;
-    if (outputAnimation.axes)
-      gr.Puts(hText, vText - vTextSpacing, sliceString.c_str(), ":AL");
-  }
-  }
-  gr.SetPlotFactor(1.3);
-
-  if (outputAnimation.axes)
-  {
-    gr.Axis("yU");
-    gr.Axis("x");
-    if (outputAnimation.colorScheme == OutputAnimation::C_CMR)
-    {
-      gr.Colorbar("kUrqyw_");
-    }
-    else if (outputAnimation.colorScheme == OutputAnimation::C_JET)
-    {
-      gr.Colorbar("BbcyrR_");
-    }
-  }
-
-  if (outputAnimation.colorScheme == OutputAnimation::C_CMR)
-  {
-    gr.Dens(hDat, vDat, TDat,"kUrqyw");
-  }
-  else if (outputAnimation.colorScheme == OutputAnimation::C_JET)
-  {
-    gr.Dens(hDat, vDat, TDat,"BbcyrR");
+    sliceLabel = "X = " + str(boost::format("%0.2f") % (slice*distanceUnitConversion)) + " " + distanceUnit;
   }
 
-  gr.Box("k",false);
-
-  if (outputAnimation.contours)
-  {
-    if (outputAnimation.contourLabels)
-      gr.Cont(cDat, hDat, vDat, TDat,(outputAnimation.contourColor + "t").c_str());
-    else
-      gr.Cont(cDat, hDat, vDat, TDat,outputAnimation.contourColor.c_str());
-  }
-  if (outputAnimation.gradients)
-    gr.Grad(hDat, vDat, TDat);
-  if (outputAnimation.grid)
-    gr.Grid(hGrid, vGrid, TGrid, "W");
-
-
-  // Draw blocks
+  // Block outlines (pairs of end points) within the viewing window
   for (size_t b = 0; b < blocks.size(); b++)
   {
     switch (sliceType)
@@ -360,10 +247,14 @@ void GroundPlot::createFrame(std::string timeStamp)
                    std::max(std::min(blocks[b].zMax*distanceUnitConversion, vMax),vMin),
                    210.0);
 
-      gr.Line(bl, br, "k");
-      gr.Line(br, tr, "k");
-      gr.Line(tr, tl, "k");
-      gr.Line(tl, bl, "k");
+      blockLines.push_back(bl);
+      blockLines.push_back(br);
+      blockLines.push_back(br);
+      blockLines.push_back(tr);
+      blockLines.push_back(tr);
+      blockLines.push_back(tl);
+      blockLines.push_back(tl);
+      blockLines.push_back(bl);
     }
     break;
     case XY:
@@ -385,13 +276,11 @@ void GroundPlot::createFrame(std::string timeStamp)
         std::size_t nV = intersection[p].outer().size();
         for (std::size_t v = 0; v < nV - 1; v++)
         {
-          gr.Line(mglPoint(intersection[p].outer()[v].get<0>()*distanceUnitConversion,intersection[p].outer()[v].get<1>()*distanceUnitConversion,210.0),
-              mglPoint(intersection[p].outer()[v+1].get<0>()*distanceUnitConversion,intersection[p].outer()[v+1].get<1>()*distanceUnitConversion,210.0),
-              "k");
+          blockLines.push_back(mglPoint(intersection[p].outer()[v].get<0>()*distanceUnitConversion,intersection[p].outer()[v].get<1>()*distanceUnitConversion,210.0));
+          blockLines.push_back(mglPoint(intersection[p].outer()[v+1].get<0>()*distanceUnitConversion,intersection[p].outer()[v+1].get<1>()*distanceUnitConversion,210.0));
         }
-        gr.Line(mglPoint(intersection[p].outer()[nV - 1].get<0>()*distanceUnitConversion,intersection[p].outer()[nV - 1].get<1>()*distanceUnitConversion,210.0),
-            mglPoint(intersection[p].outer()[0].get<0>()*distanceUnitConversion,intersection[p].outer()[0].get<1>()*distanceUnitConversion,210.0),
-            "k");
+        blockLines.push_back(mglPoint(intersection[p].outer()[nV - 1].get<0>()*distanceUnitConversion,intersection[p].outer()[nV - 1].get<1>()*distanceUnitConversion,210.0));
+        blockLines.push_back(mglPoint(intersection[p].outer()[0].get<0>()*distanceUnitConversion,intersection[p].outer()[0].get<1>()*distanceUnitConversion,210.0));
       }
     }
     break;
@@ -429,10 +318,14 @@ void GroundPlot::createFrame(std::string timeStamp)
                      std::max(std::min(blocks[b].zMax*distanceUnitConversion, vMax),vMin),
                      210.0);
 
-        gr.Line(bl, br, "k");
-        gr.Line(br, tr, "k");
-        gr.Line(tr, tl, "k");
-        gr.Line(tl, bl, "k");
+        blockLines.push_back(bl);
+        blockLines.push_back(br);
+        blockLines.push_back(br);
+        blockLines.push_back(tr);
+        blockLines.push_back(tr);
+        blockLines.push_back(tl);
+        blockLines.push_back(tl);
+        blockLines.push_back(bl);
 
         p += 1; // skip one point, on to the next pair
       }
@@ -472,10 +365,14 @@ void GroundPlot::createFrame(std::string timeStamp)
                      std::max(std::min(blocks[b].zMax*distanceUnitConversion, vMax),vMin),
                      210.0);
 
-        gr.Line(bl, br, "k");
-        gr.Line(br, tr, "k");
-        gr.Line(tr, tl, "k");
-        gr.Line(tl, bl, "k");
+        blockLines.push_back(bl);
+        blockLines.push_back(br);
+        blockLines.push_back(br);
+        blockLines.push_back(tr);
+        blockLines.push_back(tr);
+        blockLines.push_back(tl);
+        blockLines.push_back(tl);
+        blockLines.push_back(bl);
 
         p += 1; // skip one point, on to the next pair
       }
@@ -484,13 +381,138 @@ void GroundPlot::createFrame(std::string timeStamp)
     }
   }
 
-  if (outputAnimation.format == OutputAnimation::F_PNG)
-    gr.WritePNG((outputAnimation.dir + "/" + str(boost::format("%04d") % frameNumber) + ".png").c_str(),"",false);
-  else if (outputAnimation.format == OutputAnimation::F_TEX)
-    gr.WriteTEX((outputAnimation.dir + "/" + str(boost::format("%04d") % frameNumber) + ".tex").c_str());
+}
 
-  frameNumber += 1;
+int GroundPlot::beginFrame()
+{
   nextPlotTime += outputAnimation.frequency;
+  return frameNumber++;
+}
+
+void GroundPlot::createFrame(std::string timeStamp, const std::vector<double> &values, int frame) const
+{
+  Tracer::Scope trace("Render snapshot");
+  mglData TDat(hAxis.nN,vAxis.nN);
+  for (std::size_t n = 0; n < hAxis.nN*vAxis.nN; n++)
+    TDat.a[n] = values[n];
+
+
+  std::string temperatureUnit;
+  std::string fluxUnit;
+
+  if (outputAnimation.outputUnits == OutputAnimation::IP)
+  {
+    temperatureUnit = "\\textdegree F";
+    fluxUnit = "W/ft^2";
+  }
+  else
+  {
+    temperatureUnit = "\\textdegree C";
+    fluxUnit = "W/m^2";
+  }
+
+  double hRange = hMax - hMin;
+  double vRange = vMax - vMin;
+
+  int nT = cDat.GetNN();
+  double Tmin = cDat.a[0];
+  double Tmax = cDat.a[nT - 1];
+  double Tstep = cDat.a[1] - cDat.a[0];
+
+  // Text properties
+  double hText = 0.05;
+  double vText = 0.95;
+
+  double vTextSpacing = 0.05;
+
+  mglGraph gr;
+  gr.CopyFont(&getFont());
+
+  // Plot
+  gr.Clf(1,1,1);
+  double aspect = 1.0;
+  int height = outputAnimation.size;
+  int width = height*aspect;
+
+
+  gr.SetSize(width,height);
+
+  gr.SetFontSize(2.0);
+  gr.SetRange('x', hGrid);
+  gr.SetRange('y', vGrid);
+  gr.SetRange('c', Tmin, Tmax);
+  gr.SetRange('z', Tmin, Tmax);
+  gr.SetTicks('c', Tstep, nT, Tmin);
+  gr.Aspect(hRange, vRange);
+
+
+  // Timestamp
+
+  std::string timeStampMinusYear = timeStamp.substr(5,timeStamp.size()-5);
+  if (outputAnimation.axes)
+  {
+    if (outputAnimation.colorScheme != OutputAnimation::C_NONE)
+    {
+      if  (outputAnimation.plotType == OutputAnimation::P_TEMP)
+        gr.Puts(0.9, 0.056, temperatureUnit.c_str(), ":AL");
+      else
+        gr.Puts(0.9, 0.056, fluxUnit.c_str(), ":AL");
+    }
+  }
+
+  if (outputAnimation.timestamp)
+    gr.Puts(hText, vText, timeStampMinusYear.c_str(), ":AL");
+
+  if (outputAnimation.axes && !sliceLabel.empty())
+    gr.Puts(hText, vText - vTextSpacing, sliceLabel.c_str(), ":AL");
+  gr.SetPlotFactor(1.3);
+
+  if (outputAnimation.axes)
+  {
+    gr.Axis("yU");
+    gr.Axis("x");
+    if (outputAnimation.colorScheme == OutputAnimation::C_CMR)
+    {
+      gr.Colorbar("kUrqyw_");
+    }
+    else if (outputAnimation.colorScheme == OutputAnimation::C_JET)
+    {
+      gr.Colorbar("BbcyrR_");
+    }
+  }
+
+  if (outputAnimation.colorScheme == OutputAnimation::C_CMR)
+  {
+    gr.Dens(hDat, vDat, TDat,"kUrqyw");
+  }
+  else if (outputAnimation.colorScheme == OutputAnimation::C_JET)
+  {
+    gr.Dens(hDat, vDat, TDat,"BbcyrR");
+  }
+
+  gr.Box("k",false);
+
+  if (outputAnimation.contours)
+  {
+    if (outputAnimation.contourLabels)
+      gr.Cont(cDat, hDat, vDat, TDat,(outputAnimation.contourColor + "t").c_str());
+    else
+      gr.Cont(cDat, hDat, vDat, TDat,outputAnimation.contourColor.c_str());
+  }
+  if (outputAnimation.gradients)
+    gr.Grad(hDat, vDat, TDat);
+  if (outputAnimation.grid)
+    gr.Grid(hGrid, vGrid, TGrid, "W");
+
+
+  // Draw blocks
+  for (std::size_t l = 0; l + 1 < blockLines.size(); l += 2)
+    gr.Line(blockLines[l], blockLines[l + 1], "k");
+
+  if (outputAnimation.format == OutputAnimation::F_PNG)
+    gr.WritePNG((outputAnimation.dir + "/" + str(boost::format("%04d") % frame) + ".png").c_str(),"",false);
+  else if (outputAnimation.format == OutputAnimation::F_TEX)
+    gr.WriteTEX((outputAnimation.dir + "/" + str(boost::format("%04d") % frame) + ".tex").c_str());
 }
 
 bool GroundPlot::makeNewFrame(boost::posix_time::ptime t)
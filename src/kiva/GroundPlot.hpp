@@ -45,7 +45,10 @@ private:
   Axis hAxis;
   Axis vAxis;
 
-  int frameNumber;
+  // Parts of every frame that do not change
+  double hMin, hMax, vMin, vMax;
+  std::string sliceLabel;
+  std::vector<mglPoint> blockLines;  // pairs of end points
 
 
 public:
@@ -55,16 +58,23 @@ public:
   std::vector<Block> blocks;
   SliceType sliceType;
 
-  mglData TDat;
   std::size_t iMin, iMax, jMin, jMax, kMin, kMax;
 
   double distanceUnitConversion;
 
   boost::posix_time::ptime tStart, tEnd;
   boost::posix_time::ptime nextPlotTime;
+  int frameNumber;  // of the next frame
   GroundPlot(OutputAnimation &outputAnimation, Domain &domain, std::vector<Block> &blocks);
-  void createFrame(std::string timeStamp);
   bool makeNewFrame(boost::posix_time::ptime t);
+
+  // Advances to the next frame and returns its number
+  int beginFrame();
+
+  // Renders frame number frame from the values of the slice cells (i, j, k),
+  // indexed (i - iMin) + nI*(j - jMin) + nI*nJ*(k - kMin). Only reads the
+  // plot, so frames may be rendered on another thread.
+  void createFrame(std::string timeStamp, const std::vector<double> &values, int frame) const;
 };
 
 
@@ -0,0 +1,94 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef InitializationCache_CPP
+#define InitializationCache_CPP
+
+#include "InitializationCache.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Checkpoint.hpp"
+#include "WeatherData.hpp"
+
+static const char* entryExtension = ".kic";
+
+InitializationCache::InitializationCache(std::string directory, double maximumSize,
+                                         std::string version) :
+  directory(directory),
+  maximumSize(maximumSize),
+  version(version)
+{
+  boost::system::error_code error;
+  boost::filesystem::create_directories(directory, error);
+}
+
+std::string InitializationCache::getVersion() const
+{
+  return version;
+}
+
+std::string InitializationCache::getFileName(const std::string &key) const
+{
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0')
+       << DelimitedText::getHash(key.data(), key.size()) << entryExtension;
+  return (boost::filesystem::path(directory) / name.str()).string();
+}
+
+bool InitializationCache::contains(const std::string &key) const
+{
+  return Checkpoint::isComplete(getFileName(key));
+}
+
+void InitializationCache::touch(const std::string &key)
+{
+  boost::system::error_code error;
+  boost::filesystem::last_write_time(getFileName(key), std::time(NULL), error);
+}
+
+void InitializationCache::trim(const std::string &key)
+{
+  boost::filesystem::path keptPath(getFileName(key));
+
+  // Failures (e.g., entries removed by another run) are ignored
+  boost::system::error_code error;
+  boost::filesystem::directory_iterator entry(directory, error), end;
+  if (error)
+    return;
+
+  std::vector<std::pair<std::time_t, boost::filesystem::path>> entries;
+  double totalSize = 0.0;  // [MB]
+  for (; entry != end; entry.increment(error))
+  {
+    if (error)
+      return;
+    if (entry->path().extension() != entryExtension)
+      continue;
+
+    boost::uintmax_t size = boost::filesystem::file_size(entry->path(), error);
+    std::time_t time = boost::filesystem::last_write_time(entry->path(), error);
+    if (error)
+      continue;
+
+    totalSize += double(size)/(1024.0*1024.0);
+    if (entry->path().filename() != keptPath.filename())
+      entries.push_back(std::make_pair(time, entry->path()));
+  }
+
+  std::sort(entries.begin(), entries.end());
+  for (std::size_t e = 0; e < entries.size() && totalSize > maximumSize; e++)
+  {
+    boost::uintmax_t size = boost::filesystem::file_size(entries[e].second, error);
+    if (!error && boost::filesystem::remove(entries[e].second, error))
+      totalSize -= double(size)/(1024.0*1024.0);
+  }
+}
+
+#endif
@@ -0,0 +1,44 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef INITIALIZATIONCACHE_H_
+#define INITIALIZATIONCACHE_H_
+
+#include <string>
+
+// Directory of initialized ground temperatures, stored as checkpoints named
+// by a 64-bit hash of the key (a description of everything that determines
+// them, including the version of Kiva that calculated them). When the
+// directory grows beyond its maximum size, the least recently used entries
+// are removed.
+class InitializationCache
+{
+public:
+
+  InitializationCache(std::string directory, double maximumSize,  // [MB]
+                      std::string version);
+
+  std::string getVersion() const;
+
+  std::string getFileName(const std::string &key) const;
+
+  // True if a complete entry exists for the key's hash (the entry's stored
+  // key should still be compared with the key)
+  bool contains(const std::string &key) const;
+
+  // Marks an entry as recently used
+  void touch(const std::string &key);
+
+  // Removes the least recently used entries (other than the key's entry)
+  // until the directory is within its maximum size
+  void trim(const std::string &key);
+
+private:
+
+  std::string directory;
+  double maximumSize;  // [MB]
+  std::string version;
+
+};
+
+#endif /* INITIALIZATIONCACHE_H_ */
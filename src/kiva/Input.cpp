@@ -85,6 +85,7 @@ OutputVariable::OutputVariable(int varID)
   headerText = headers[varID];
   surfaces = surfaceTypes[varID];
   outType = outTypes[varID];
+  aggregation = A_MEAN;
 }
 
 void OutputReport::setOutputMap()
@@ -120,36 +121,28 @@ void DataFile::readData()
       }
   }
 
-  std::ifstream file(dataFilePath.string().c_str());
+  DelimitedText text;
 
-  if (!file.is_open())
+  if (!text.open(dataFilePath.string()))
   {
     // Print an error and exit
     std::cerr << "Unable to read data file" << std::endl;
     exit(EXIT_FAILURE);
   }
 
-  // While there's still stuff left to read
-  std::string line;
-  std::vector <std::string> columns;
+  hash = text.getHash();
 
-  typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
   int row = 0;
 
-  while (!safeGetline(file,line).eof())
+  while (text.nextRow())
   {
     row += 1;
-    Tokenizer tok(line, boost::escaped_list_separator<char>("\\",",","\""));
-
-    columns.assign(tok.begin(), tok.end());
 
     if (row > firstIndex.first)
     {
-      data.push_back(double(boost::lexical_cast<double>(columns[firstIndex.second])));
+      data.push_back(text.getDouble(firstIndex.second));
     }
-    columns.clear();
   }
-  file.close();
 }
 
 #endif /* INPUT_CPP_ */
@@ -29,6 +29,13 @@ public:
   std::string weatherFile;
   boost::posix_time::ptime startTime;
 
+  // Parareal time-parallel integration
+  bool parareal;
+  long pararealSlices;
+  boost::posix_time::time_duration pararealCoarseTimestep;
+  double pararealTolerance;  // [K]
+  long pararealMaxIterations;
+
   void setStartTime();
 };
 
@@ -47,6 +54,10 @@ public:
   long implicitAccelTimestep;
   long implicitAccelPeriods;
 
+  bool convergeWarmup;
+  double warmupConvergenceTolerance;  // [K]
+  long warmupConvergenceInterval;  // [days]
+
   InitializationMethod initializationMethod;
 };
 
@@ -122,6 +133,29 @@ public:
 
 };
 
+class OutputField
+{
+public:
+
+  std::string fileName;
+  boost::posix_time::time_duration frequency;
+  boost::gregorian::date startDate;
+  boost::gregorian::date endDate;
+  std::pair<double, double> xRange;
+  std::pair<double, double> yRange;
+  std::pair<double, double> zRange;
+
+  double precision;  // [K] quantization step
+  long keyframeInterval;  // [frames] between frames stored without deltas
+
+  bool startDateSet;
+  bool endDateSet;
+  bool xRangeSet;
+  bool yRangeSet;
+  bool zRangeSet;
+
+};
+
 class OutputVariable
 {
 private:
@@ -135,6 +169,15 @@ public:
   std::vector<Surface::SurfaceType> surfaces;
   GroundOutput::OutputType outType;
 
+  enum Aggregation
+  {
+    A_MEAN,
+    A_SUM,  // time integral [value*s]
+    A_MINIMUM,
+    A_MAXIMUM
+  };
+  Aggregation aggregation;
+
   OutputVariable(int varID);
 
 };
@@ -145,6 +188,25 @@ public:
   void setOutputMap();
   std::map<Surface::SurfaceType, std::vector<GroundOutput::OutputType>> outputMap;
   boost::posix_time::time_duration minFrequency;
+
+  // Reports are written every timestep (limited by minFrequency) unless
+  // they are aggregated over a reporting interval
+  enum Interval
+  {
+    I_TIMESTEP,
+    I_HOURLY,
+    I_DAILY,
+    I_MONTHLY,
+    I_RUN
+  };
+  Interval interval;
+
+  enum Format
+  {
+    F_CSV,
+    F_BINARY
+  };
+  Format format;
 };
 
 class Output
@@ -152,6 +214,7 @@ class Output
 public:
   OutputReport outputReport;
   std::vector<OutputAnimation> outputAnimations;
+  std::vector<OutputField> outputFields;
 };
 
 class DataFile
@@ -161,6 +224,7 @@ public:
   std::pair<int, int> firstIndex;
   HourlyData data;
   boost::filesystem::path searchDir;
+  unsigned long long hash;  // of the file contents
 
   void readData();
 
@@ -180,6 +244,9 @@ public:
 
   IndoorTemperatureMethod indoorTemperatureMethod;
 
+  // Additional indoor air temperature schedules simulated as an ensemble
+  std::vector<DataFile> indoorAirTemperatureEnsemble;
+
   // Local wind speed characteristics
   double deltaLocal;  // [m]
   double alphaLocal;  // [-]
@@ -202,6 +269,10 @@ public:
   Boundaries boundaries;
   Initialization initialization;
   Output output;
+
+  // Input (as normalized YAML) that can affect the initialized temperatures:
+  // everything except the simulation end date, ensemble, and output
+  std::string initializationKey;
 };
 
 #endif /* INPUT_HPP_ */
@@ -25,6 +25,58 @@ Input inputParser(std::string inputFile)
   simulationControl.timestep =
       boost::posix_time::minutes(yamlInput["Simulation Control"]["Timestep"].as<long>());
 
+  if (yamlInput["Simulation Control"]["Parareal"].IsDefined())
+  {
+    YAML::Node pararealNode = yamlInput["Simulation Control"]["Parareal"];
+    simulationControl.parareal = true;
+
+    if (pararealNode["Time Slices"].IsDefined())
+    {
+      simulationControl.pararealSlices = pararealNode["Time Slices"].as<long>();
+      if (simulationControl.pararealSlices < 0)
+      {
+        std::cerr << "Error: Parareal time slices cannot be negative." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else
+      simulationControl.pararealSlices = 0;
+
+    if (pararealNode["Coarse Timestep"].IsDefined())
+    {
+      long coarseTimestep = pararealNode["Coarse Timestep"].as<long>();
+      if (coarseTimestep < 1)
+      {
+        std::cerr << "Error: Parareal coarse timestep must be greater than zero." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      simulationControl.pararealCoarseTimestep = boost::posix_time::hours(coarseTimestep);
+    }
+    else
+      simulationControl.pararealCoarseTimestep = boost::posix_time::hours(24);
+
+    if (pararealNode["Tolerance"].IsDefined())
+      simulationControl.pararealTolerance = pararealNode["Tolerance"].as<double>();
+    else
+      simulationControl.pararealTolerance = 0.01;
+
+    if (pararealNode["Maximum Iterations"].IsDefined())
+    {
+      simulationControl.pararealMaxIterations = pararealNode["Maximum Iterations"].as<long>();
+      if (simulationControl.pararealMaxIterations < 1)
+      {
+        std::cerr << "Error: Parareal maximum iterations must be at least one." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else
+      simulationControl.pararealMaxIterations = 100;
+  }
+  else
+  {
+    simulationControl.parareal = false;
+  }
+
   // MATERIALS
   std::map<std::string, Material> materials;
 
@@ -276,6 +328,38 @@ Input inputParser(std::string inputFile)
     foundation.buildingHeight = 0.0;
   }
 
+  foundation.shadingAngularResolution = 0.035;  // [radians] (about 2 degrees)
+  foundation.shadingSamples = 4;
+
+  if  (yamlInput["Foundation"]["Exterior Shading"].IsDefined())
+  {
+    foundation.exteriorShading = true;
+
+    // Shadows are traced from the full building, so the domain cannot be
+    // reduced by symmetry
+    if (foundation.numberOfDimensions != 3 ||
+        (foundation.useSymmetry &&
+         (isXSymmetric(foundation.polygon) || isYSymmetric(foundation.polygon))))
+    {
+      std::cerr << "Error: Exterior shading requires a three-dimensional simulation without symmetry." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    if  (yamlInput["Foundation"]["Exterior Shading"]["Angular Resolution"].IsDefined())
+    {
+      foundation.shadingAngularResolution = yamlInput["Foundation"]["Exterior Shading"]["Angular Resolution"].as<double>();
+    }
+
+    if  (yamlInput["Foundation"]["Exterior Shading"]["Samples per Side"].IsDefined())
+    {
+      foundation.shadingSamples = yamlInput["Foundation"]["Exterior Shading"]["Samples per Side"].as<int>();
+    }
+  }
+  else
+  {
+    foundation.exteriorShading = false;
+  }
+
   if  (yamlInput["Foundation"]["Perimeter Surface Width"].IsDefined())
   {
     foundation.hasPerimeterSurface = true;
@@ -456,6 +540,21 @@ Input inputParser(std::string inputFile)
     boundaries.indoorAirTemperature = yamlInput["Boundaries"]["Indoor Air Temperature"].as<double>();
   }
 
+  if (yamlInput["Boundaries"]["Indoor Air Temperature Ensemble"].IsDefined())
+  {
+    for (size_t i=0;i<yamlInput["Boundaries"]["Indoor Air Temperature Ensemble"].size();i++)
+    {
+      YAML::Node memberNode = yamlInput["Boundaries"]["Indoor Air Temperature Ensemble"][i];
+      DataFile temp;
+      temp.fileName = memberNode["Name"].as<std::string>();
+      temp.firstIndex.first = memberNode["Index"][0].as<int>();
+      temp.firstIndex.second = memberNode["Index"][1].as<int>();
+      temp.searchDir = inputPath.parent_path();
+      temp.readData();
+      boundaries.indoorAirTemperatureEnsemble.push_back(temp);
+    }
+  }
+
   if (yamlInput["Boundaries"]["Local Boundary Layer Thickness"].IsDefined()) {
     boundaries.deltaLocal = yamlInput["Boundaries"]["Local Boundary Layer Thickness"].as<double>();
   }
@@ -562,15 +661,82 @@ Input inputParser(std::string inputFile)
     initialization.warmupDays = 365;
   }
 
+  if  (yamlInput["Initialization"]["Warmup Convergence Tolerance"].IsDefined())
+  {
+    initialization.convergeWarmup = true;
+    initialization.warmupConvergenceTolerance = yamlInput["Initialization"]["Warmup Convergence Tolerance"].as<double>();
+  }
+  else
+  {
+    initialization.convergeWarmup = false;
+    initialization.warmupConvergenceTolerance = 0.0;
+  }
+
+  if  (yamlInput["Initialization"]["Warmup Convergence Interval"].IsDefined())
+  {
+    initialization.warmupConvergenceInterval = yamlInput["Initialization"]["Warmup Convergence Interval"].as<long>();
+    if (initialization.warmupConvergenceInterval < 1 || initialization.warmupConvergenceInterval > 365)
+    {
+      std::cerr << "Error: Warmup convergence interval must be between 1 and 365 days." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  else
+  {
+    initialization.warmupConvergenceInterval = 365;
+  }
+
   // OUTPUT
 
   // CSV Reports
+  output.outputReport.interval = OutputReport::I_TIMESTEP;
   if  (yamlInput["Output"]["Output Report"].IsDefined())
   {
     for(size_t i=0;i<yamlInput["Output"]["Output Report"]["Reports"].size();i++)
     {
-      OutputVariable temp(yamlInput["Output"]["Output Report"]["Reports"][i].as<int>());
-      output.outputReport.push_back(temp);
+      YAML::Node report = yamlInput["Output"]["Output Report"]["Reports"][i];
+      if (report.IsMap())
+      {
+        OutputVariable temp(report["Variable"].as<int>());
+        if (report["Reporting Interval"].IsDefined())
+        {
+          std::cerr << "Error: Reporting Interval applies to the entire Output Report and cannot be specified for individual reports." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        if (report["Aggregation"].IsDefined())
+        {
+          std::string aggregation = report["Aggregation"].as<std::string>();
+          if (aggregation == "MEAN")
+            temp.aggregation = OutputVariable::A_MEAN;
+          else if (aggregation == "SUM")
+            temp.aggregation = OutputVariable::A_SUM;
+          else if (aggregation == "MINIMUM")
+            temp.aggregation = OutputVariable::A_MINIMUM;
+          else if (aggregation == "MAXIMUM")
+            temp.aggregation = OutputVariable::A_MAXIMUM;
+        }
+        output.outputReport.push_back(temp);
+      }
+      else
+      {
+        OutputVariable temp(report.as<int>());
+        output.outputReport.push_back(temp);
+      }
+    }
+
+    if  (yamlInput["Output"]["Output Report"]["Reporting Interval"].IsDefined())
+    {
+      std::string interval = yamlInput["Output"]["Output Report"]["Reporting Interval"].as<std::string>();
+      if (interval == "TIMESTEP")
+        output.outputReport.interval = OutputReport::I_TIMESTEP;
+      else if (interval == "HOURLY")
+        output.outputReport.interval = OutputReport::I_HOURLY;
+      else if (interval == "DAILY")
+        output.outputReport.interval = OutputReport::I_DAILY;
+      else if (interval == "MONTHLY")
+        output.outputReport.interval = OutputReport::I_MONTHLY;
+      else if (interval == "RUN")
+        output.outputReport.interval = OutputReport::I_RUN;
     }
 
     if  (yamlInput["Output"]["Output Report"]["Minimum Reporting Frequency"].IsDefined())
@@ -586,6 +752,15 @@ Input inputParser(std::string inputFile)
     output.outputReport.setOutputMap();
   }
 
+  output.outputReport.format = OutputReport::F_CSV;
+  if  (yamlInput["Output"]["Output Report"]["Format"].IsDefined())
+  {
+    if (yamlInput["Output"]["Output Report"]["Format"].as<std::string>() == "CSV")
+      output.outputReport.format = OutputReport::F_CSV;
+    else if (yamlInput["Output"]["Output Report"]["Format"].as<std::string>() == "BINARY")
+      output.outputReport.format = OutputReport::F_BINARY;
+  }
+
   // Animations/Plots
   for(size_t i=0;i<yamlInput["Output"]["Output Snapshots"].size();i++)
   {
@@ -780,6 +955,92 @@ Input inputParser(std::string inputFile)
     output.outputAnimations.push_back(temp);
   }
 
+  // Raw temperature fields
+  for(size_t i=0;i<yamlInput["Output"]["Output Fields"].size();i++)
+  {
+    YAML::Node fieldNode = yamlInput["Output"]["Output Fields"][i];
+    OutputField temp;
+    temp.fileName = fieldNode["File"].as<std::string>();
+
+    if (fieldNode["Frequency"].IsDefined())
+      temp.frequency = boost::posix_time::hours(fieldNode["Frequency"].as<long>());
+    else
+      temp.frequency = boost::posix_time::hours(24);
+
+    if (fieldNode["Precision"].IsDefined())
+      temp.precision = fieldNode["Precision"].as<double>();
+    else
+      temp.precision = 0.001;
+
+    if (temp.precision <= 0.0)
+    {
+      std::cerr << "Error: Output field precision must be greater than zero." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    if (fieldNode["Keyframe Interval"].IsDefined())
+      temp.keyframeInterval = std::max(fieldNode["Keyframe Interval"].as<long>(), 1L);
+    else
+      temp.keyframeInterval = 24;
+
+    if (fieldNode["Start Date"].IsDefined())
+    {
+      temp.startDate = boost::gregorian::from_string(fieldNode["Start Date"].as<std::string>());
+      temp.startDateSet = true;
+    }
+    else
+      temp.startDateSet = false;
+
+    if (fieldNode["End Date"].IsDefined())
+    {
+      temp.endDate = boost::gregorian::from_string(fieldNode["End Date"].as<std::string>());
+      temp.endDateSet = true;
+    }
+    else
+      temp.endDateSet = false;
+
+    if (fieldNode["X Range"].IsDefined())
+    {
+      temp.xRange.first = fieldNode["X Range"][0].as<double>();
+      temp.xRange.second = fieldNode["X Range"][1].as<double>();
+      temp.xRangeSet = true;
+    }
+    else
+      temp.xRangeSet = false;
+
+    if (fieldNode["Y Range"].IsDefined())
+    {
+      temp.yRange.first = fieldNode["Y Range"][0].as<double>();
+      temp.yRange.second = fieldNode["Y Range"][1].as<double>();
+      temp.yRangeSet = true;
+    }
+    else
+      temp.yRangeSet = false;
+
+    if (fieldNode["Z Range"].IsDefined())
+    {
+      temp.zRange.first = fieldNode["Z Range"][0].as<double>();
+      temp.zRange.second = fieldNode["Z Range"][1].as<double>();
+      temp.zRangeSet = true;
+    }
+    else
+      temp.zRangeSet = false;
+
+    output.outputFields.push_back(temp);
+  }
+
+  // Initialized ground temperatures depend on everything but the end date,
+  // the ensemble, and the outputs (warmup convergence is checked on the
+  // foundation surfaces whether or not they are reported)
+  YAML::Node keyNode = YAML::Clone(yamlInput);
+  keyNode["Simulation Control"].remove("End Date");
+  if (keyNode["Boundaries"].IsMap())
+    keyNode["Boundaries"].remove("Indoor Air Temperature Ensemble");
+  keyNode.remove("Output");
+  YAML::Emitter keyEmitter;
+  keyEmitter << keyNode;
+  input.initializationKey = keyEmitter.c_str();
+
   // Full Input
   input.simulationControl = simulationControl;
   input.foundation = foundation;
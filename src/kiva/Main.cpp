@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <memory>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
@@ -19,8 +20,27 @@
 
 namespace po = boost::program_options;
 
+static void finalize()
+{
+  lis_finalize();
+#ifdef ENABLE_MPI
+  MPI_Finalize();
+#endif
+}
+
 int main(int argc, char *argv[])
 {
+  int rank = 0;
+#ifdef ENABLE_MPI
+  MPI_Init(&argc, &argv);
+
+  // Only the root process reports to the console
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  static std::ofstream nullStream;  // never opened, so output is discarded
+  if (rank != 0)
+    std::cout.rdbuf(nullStream.rdbuf());
+#endif
+
   lis_initialize(&argc, &argv);
 
   std::string versionInfo = "kiva ";
@@ -40,7 +60,16 @@ int main(int argc, char *argv[])
     po::options_description generic("Options");
     generic.add_options()
         ("help,h", "Produce this message")
-        ("version,v", "Display version information");
+        ("version,v", "Display version information")
+        ("weather-cache", po::value<std::string>(), "Directory for cached preprocessed weather data")
+        ("checkpoint", po::value<std::string>(), "Write the simulation state to this file at the end of the simulation")
+        ("checkpoint-frequency", po::value<long>(), "Also write the checkpoint after every interval of simulated time [hours]")
+        ("restart", po::value<std::string>(), "Resume the simulation from this checkpoint file")
+        ("initialization-cache", po::value<std::string>(), "Directory for cached initialized temperatures")
+        ("initialization-cache-size", po::value<double>()->default_value(1024.0), "Maximum size of the initialization cache [MB]")
+        ("timing", "Report the time spent in each phase of the run")
+        ("timing-file", po::value<std::string>(), "Write the timing report to this file as JSON")
+        ("trace", po::value<std::string>(), "Write a timeline of solver and output events to this file (Chrome trace format)");
 
         po::options_description hidden("Hidden options");
         hidden.add_options()
@@ -86,18 +115,55 @@ int main(int argc, char *argv[])
       boost::posix_time::ptime beginCalc = boost::posix_time::microsec_clock::local_time();
       std::cout << "Starting Program: " << beginCalc << std::endl;
 
+      if (vm.count("trace"))
+      {
+        Kiva::Tracer::enable();
+        Kiva::Tracer::setThreadName("Main");
+      }
+
+      std::unique_ptr<PhaseTimer> timer;
+      if (vm.count("timing") || vm.count("timing-file"))
+        timer.reset(new PhaseTimer());
+
       // parse input
+      if (timer)
+        timer->start(PhaseTimer::PH_INPUT);
       Input input = inputParser(vm["input-file"].as<std::string>());
+      if (timer)
+        timer->stop(PhaseTimer::PH_INPUT);
 
       // parse weather
-      WeatherData weather(vm["weather-file"].as<std::string>());
+      std::string weatherCache;
+      if (vm.count("weather-cache"))
+        weatherCache = vm["weather-cache"].as<std::string>();
+      if (timer)
+        timer->start(PhaseTimer::PH_WEATHER);
+      WeatherData weather(vm["weather-file"].as<std::string>(), weatherCache);
+      if (timer)
+        timer->stop(PhaseTimer::PH_WEATHER);
 
       input.simulationControl.setStartTime();
 
       // initialize
-      Simulator simulator(weather,input,vm["output-file"].as<std::string>());
-
-      simulator.simulate();
+      std::string restartFile;
+      if (vm.count("restart"))
+        restartFile = vm["restart"].as<std::string>();
+      std::unique_ptr<InitializationCache> initializationCache;
+      if (vm.count("initialization-cache"))
+        initializationCache.reset(new InitializationCache(vm["initialization-cache"].as<std::string>(),
+                                                          vm["initialization-cache-size"].as<double>(),
+                                                          Kiva::getVersion()));
+      {
+        Simulator simulator(weather,input,vm["output-file"].as<std::string>(),restartFile,
+                            initializationCache.get(),timer.get());
+
+        if (vm.count("checkpoint"))
+          simulator.checkpointFileName = vm["checkpoint"].as<std::string>();
+        if (vm.count("checkpoint-frequency"))
+          simulator.checkpointFrequency = boost::posix_time::hours(vm["checkpoint-frequency"].as<long>());
+
+        simulator.simulate();
+      } // output is complete (and background threads are stopped) once the simulator is destroyed
 
       boost::posix_time::ptime finishCalc = boost::posix_time::microsec_clock::local_time();
       std::cout << "Finished Program: " << finishCalc << std::endl;
@@ -105,6 +171,39 @@ int main(int argc, char *argv[])
       boost::posix_time::time_duration totalCalc = finishCalc - beginCalc;
       std::cout << "Elapsed Time: " << totalCalc << std::endl;
 
+      if (timer)
+      {
+        if (vm.count("timing"))
+        {
+          std::cout << std::endl;
+          timer->writeReport(std::cout);
+        }
+
+        if (vm.count("timing-file") && rank == 0)
+        {
+          std::ofstream timingFile(vm["timing-file"].as<std::string>());
+          if (!timingFile)
+          {
+            std::cerr << "Error: Unable to write timing report \"" << vm["timing-file"].as<std::string>() << "\"." << std::endl;
+            finalize();
+            return 1;
+          }
+          timer->writeJSON(timingFile, Kiva::getVersion());
+        }
+      }
+
+      if (vm.count("trace") && rank == 0)
+      {
+        std::ofstream traceFile(vm["trace"].as<std::string>());
+        if (!traceFile)
+        {
+          std::cerr << "Error: Unable to write trace \"" << vm["trace"].as<std::string>() << "\"." << std::endl;
+          finalize();
+          return 1;
+        }
+        Kiva::Tracer::write(traceFile);
+      }
+
     }
     else if (!vm.empty())
     {
@@ -113,18 +212,18 @@ int main(int argc, char *argv[])
       std::cout << usageInfo << "\n";
       std::cout << generic;
 
-      lis_finalize();
+      finalize();
       return 1;
     }
 
-    lis_finalize();
+    finalize();
     return 0;
 
   }
   catch(std::exception& e)
   {
     std::cerr << e.what() << std::endl;
-    lis_finalize();
+    finalize();
     return 1;
   }
 
@@ -0,0 +1,149 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef OutputAggregator_CPP
+#define OutputAggregator_CPP
+
+#include "OutputAggregator.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+OutputAggregator::OutputAggregator() :
+  interval(OutputReport::I_TIMESTEP),
+  elapsed(0.0),
+  intervalKey(0),
+  active(false)
+{
+}
+
+void OutputAggregator::initialize(const OutputReport &report)
+{
+  interval = report.interval;
+  aggregations.clear();
+  for (std::size_t o = 0; o < report.size(); o++)
+    aggregations.push_back(report[o].aggregation);
+  accumulators.assign(aggregations.size(), 0.0);
+  results.assign(aggregations.size(), 0.0);
+  active = false;
+}
+
+long OutputAggregator::getIntervalKey(boost::posix_time::ptime t) const
+{
+  switch (interval)
+  {
+  case OutputReport::I_HOURLY:
+    return long(t.date().day_number())*24 + t.time_of_day().hours();
+  case OutputReport::I_DAILY:
+    return long(t.date().day_number());
+  case OutputReport::I_MONTHLY:
+    return long(t.date().year())*12 + t.date().month();
+  default:
+    return 0;
+  }
+}
+
+bool OutputAggregator::add(boost::posix_time::ptime t, double duration, const double* values)
+{
+  long key = getIntervalKey(t);
+  bool completed = false;
+
+  if (active && key != intervalKey)
+  {
+    complete();
+    completed = true;
+  }
+
+  if (!active)
+  {
+    intervalStart = t;
+    intervalKey = key;
+    elapsed = 0.0;
+    for (std::size_t o = 0; o < aggregations.size(); o++)
+    {
+      if (aggregations[o] == OutputVariable::A_MINIMUM ||
+          aggregations[o] == OutputVariable::A_MAXIMUM)
+        accumulators[o] = values[o];
+      else
+        accumulators[o] = 0.0;
+    }
+    active = true;
+  }
+
+  for (std::size_t o = 0; o < aggregations.size(); o++)
+  {
+    switch (aggregations[o])
+    {
+    case OutputVariable::A_MINIMUM:
+      accumulators[o] = std::min(accumulators[o], values[o]);
+      break;
+    case OutputVariable::A_MAXIMUM:
+      accumulators[o] = std::max(accumulators[o], values[o]);
+      break;
+    default:
+      accumulators[o] += values[o]*duration;
+      break;
+    }
+  }
+  elapsed += duration;
+
+  return completed;
+}
+
+bool OutputAggregator::finish()
+{
+  if (!active)
+    return false;
+
+  complete();
+  return true;
+}
+
+void OutputAggregator::complete()
+{
+  for (std::size_t o = 0; o < aggregations.size(); o++)
+  {
+    if (aggregations[o] == OutputVariable::A_MEAN)
+      results[o] = elapsed > 0.0 ? accumulators[o]/elapsed : 0.0;
+    else
+      results[o] = accumulators[o];
+  }
+  resultTime = intervalStart;
+  active = false;
+}
+
+boost::posix_time::ptime OutputAggregator::getTime() const
+{
+  return resultTime;
+}
+
+const double* OutputAggregator::getValues() const
+{
+  return results.data();
+}
+
+void OutputAggregator::save(Checkpoint &checkpoint) const
+{
+  checkpoint.writeSize(active ? 1 : 0);
+  checkpoint.writeTime(intervalStart);
+  checkpoint.writeLong(intervalKey);
+  checkpoint.writeDouble(elapsed);
+  checkpoint.writeArray(accumulators);
+}
+
+void OutputAggregator::restore(Checkpoint &checkpoint)
+{
+  active = checkpoint.readSize() != 0;
+  intervalStart = checkpoint.readTime();
+  intervalKey = checkpoint.readLong();
+  elapsed = checkpoint.readDouble();
+  std::vector<double> values = checkpoint.readArray();
+  if (values.size() != accumulators.size())
+  {
+    std::cerr << "Error: Checkpoint output report does not match the input." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  accumulators = values;
+}
+
+#endif
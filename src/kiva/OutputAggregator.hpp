@@ -0,0 +1,60 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef OUTPUTAGGREGATOR_H_
+#define OUTPUTAGGREGATOR_H_
+
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/gregorian/gregorian.hpp>
+
+#include "Checkpoint.hpp"
+#include "Input.hpp"
+
+// Online aggregation of output report values over the report's interval
+// (hourly, daily, monthly, or the entire run) using constant state per
+// report variable. All variables share the report's interval (each output
+// row covers one interval); only the aggregation differs per variable.
+class OutputAggregator
+{
+public:
+
+  OutputAggregator();
+
+  void initialize(const OutputReport &report);
+
+  // Adds the values beginning at time t and lasting duration [s]. Returns
+  // true when t begins a new interval, in which case the results of the
+  // previous interval are available from getTime() and getValues().
+  bool add(boost::posix_time::ptime t, double duration, const double* values);
+
+  // Completes the current interval. Returns true if it held any values.
+  bool finish();
+
+  // Start of the last completed interval and its aggregated values
+  boost::posix_time::ptime getTime() const;
+  const double* getValues() const;
+
+  // State of the current interval
+  void save(Checkpoint &checkpoint) const;
+  void restore(Checkpoint &checkpoint);
+
+private:
+
+  OutputReport::Interval interval;
+  std::vector<OutputVariable::Aggregation> aggregations;
+  std::vector<double> accumulators;
+  std::vector<double> results;
+  double elapsed;  // [s]
+  boost::posix_time::ptime intervalStart;
+  boost::posix_time::ptime resultTime;
+  long intervalKey;
+  bool active;
+
+  long getIntervalKey(boost::posix_time::ptime t) const;
+  void complete();
+
+};
+
+#endif /* OUTPUTAGGREGATOR_H_ */
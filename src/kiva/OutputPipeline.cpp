@@ -0,0 +1,144 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef OutputPipeline_CPP
+#define OutputPipeline_CPP
+
+#include "OutputPipeline.hpp"
+#include "Tracer.hpp"
+
+#ifdef HAVE_STD_THREAD
+
+OutputPipeline::OutputPipeline(std::size_t workers, std::size_t capacity, std::string name) :
+  name(name),
+  capacity(capacity > 0 ? capacity : 1),
+  running(0),
+  stopping(false)
+{
+  for (std::size_t w = 0; w < workers; w++)
+    threads.push_back(std::thread(&OutputPipeline::work, this, w + 1));
+}
+
+OutputPipeline::~OutputPipeline()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  taskAvailable.notify_all();
+  for (std::size_t w = 0; w < threads.size(); w++)
+    threads[w].join();
+}
+
+void OutputPipeline::submit(std::function<void()> task)
+{
+  if (threads.empty())
+  {
+    task();
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (tasks.size() >= capacity)
+    {
+      Kiva::Tracer::Scope trace("Wait for queue");
+      spaceAvailable.wait(lock, [this]{return tasks.size() < capacity;});
+    }
+    tasks.push_back(std::move(task));
+  }
+  taskAvailable.notify_one();
+}
+
+void OutputPipeline::finish()
+{
+  Kiva::Tracer::Scope trace("Wait for pipeline");
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this]{return tasks.empty() && running == 0;});
+}
+
+void OutputPipeline::work(std::size_t worker)
+{
+  Kiva::Tracer::setThreadName(name + " " + std::to_string(worker));
+
+  for (;;)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      taskAvailable.wait(lock, [this]{return stopping || !tasks.empty();});
+      if (tasks.empty())
+        return;  // stopping, and all tasks are done
+      task = std::move(tasks.front());
+      tasks.pop_front();
+      running++;
+    }
+    spaceAvailable.notify_one();
+
+    task();
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      running--;
+      if (tasks.empty() && running == 0)
+        idle.notify_all();
+    }
+  }
+}
+
+std::vector<double> OutputPipeline::getBuffer()
+{
+  std::unique_lock<std::mutex> lock(bufferMutex);
+  if (bufferPool.empty())
+    return std::vector<double>();
+  std::vector<double> buffer = std::move(bufferPool.back());
+  bufferPool.pop_back();
+  return buffer;
+}
+
+void OutputPipeline::releaseBuffer(std::vector<double> &&buffer)
+{
+  std::unique_lock<std::mutex> lock(bufferMutex);
+  bufferPool.push_back(std::move(buffer));
+}
+
+#else
+
+// Without threads, tasks run on the calling thread as they are submitted
+
+OutputPipeline::OutputPipeline(std::size_t, std::size_t capacity, std::string name) :
+  name(name),
+  capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+OutputPipeline::~OutputPipeline()
+{
+}
+
+void OutputPipeline::submit(std::function<void()> task)
+{
+  task();
+}
+
+void OutputPipeline::finish()
+{
+}
+
+std::vector<double> OutputPipeline::getBuffer()
+{
+  if (bufferPool.empty())
+    return std::vector<double>();
+  std::vector<double> buffer = std::move(bufferPool.back());
+  bufferPool.pop_back();
+  return buffer;
+}
+
+void OutputPipeline::releaseBuffer(std::vector<double> &&buffer)
+{
+  bufferPool.push_back(std::move(buffer));
+}
+
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef OUTPUTPIPELINE_H_
+#define OUTPUTPIPELINE_H_
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_STD_THREAD
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Runs output tasks (writing files, rendering snapshots) on background
+// worker threads so the time loop only waits when the bounded queue is full.
+// With a single worker, tasks run in the order they are submitted. Buffers
+// for copies of simulation data are pooled and reused between tasks. The
+// workers are named "<name> <n>" in traces (see Kiva::Tracer). Without
+// standard library threads (HAVE_STD_THREAD), there are no workers.
+class OutputPipeline
+{
+public:
+
+  OutputPipeline(std::size_t workers = 1, std::size_t capacity = 16,
+                 std::string name = "Output");
+  ~OutputPipeline();
+
+  // Queues a task, blocking while the queue is full. Tasks run immediately
+  // on the calling thread when there are no workers.
+  void submit(std::function<void()> task);
+
+  // Waits until all queued tasks have completed
+  void finish();
+
+  std::vector<double> getBuffer();
+  void releaseBuffer(std::vector<double> &&buffer);
+
+private:
+
+  std::string name;
+  std::size_t capacity;
+  std::vector<std::vector<double>> bufferPool;
+
+#ifdef HAVE_STD_THREAD
+  std::vector<std::thread> threads;
+  std::deque<std::function<void()>> tasks;
+  std::size_t running;
+  bool stopping;
+  std::mutex mutex;
+  std::condition_variable taskAvailable;
+  std::condition_variable spaceAvailable;
+  std::condition_variable idle;
+
+  std::mutex bufferMutex;
+
+  void work(std::size_t worker);
+#endif
+
+};
+
+#endif /* OUTPUTPIPELINE_H_ */
@@ -0,0 +1,526 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef OutputWriter_CPP
+#define OutputWriter_CPP
+
+#include "OutputWriter.hpp"
+#include "Tracer.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+static const std::size_t bufferSize = 1 << 20;  // [bytes] flushed when exceeded
+
+/* Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+ * with Integers", PLDI 2010). Digits always read back to the same double and
+ * are the shortest such digits in all but rare cases.
+ */
+namespace {
+
+const unsigned long long hiddenBit = 0x0010000000000000ULL;
+const unsigned long long significandMask = 0x000FFFFFFFFFFFFFULL;
+const unsigned long long exponentMask = 0x7FF0000000000000ULL;
+const int exponentBias = 0x3FF + 52;
+
+struct DiyFp
+{
+  unsigned long long f;
+  int e;
+
+  DiyFp() : f(0), e(0) {}
+  DiyFp(unsigned long long f, int e) : f(f), e(e) {}
+
+  explicit DiyFp(double d)
+  {
+    unsigned long long u;
+    memcpy(&u, &d, sizeof(d));
+    int biasedE = int((u & exponentMask) >> 52);
+    unsigned long long significand = u & significandMask;
+    if (biasedE != 0)
+    {
+      f = significand + hiddenBit;
+      e = biasedE - exponentBias;
+    }
+    else
+    {
+      f = significand;
+      e = 1 - exponentBias;
+    }
+  }
+
+  DiyFp operator-(const DiyFp &rhs) const
+  {
+    return DiyFp(f - rhs.f, e);
+  }
+
+  DiyFp operator*(const DiyFp &rhs) const
+  {
+    const unsigned long long M32 = 0xFFFFFFFFULL;
+    const unsigned long long a = f >> 32;
+    const unsigned long long b = f & M32;
+    const unsigned long long c = rhs.f >> 32;
+    const unsigned long long d = rhs.f & M32;
+    const unsigned long long ac = a*c;
+    const unsigned long long bc = b*c;
+    const unsigned long long ad = a*d;
+    const unsigned long long bd = b*d;
+    unsigned long long tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    tmp += 1ULL << 31;  // round
+    return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+  }
+
+  DiyFp normalize() const
+  {
+    DiyFp res = *this;
+    while (!(res.f & (1ULL << 63)))
+    {
+      res.f <<= 1;
+      res.e--;
+    }
+    return res;
+  }
+
+  DiyFp normalizeBoundary() const
+  {
+    DiyFp res = *this;
+    while (!(res.f & (hiddenBit << 1)))
+    {
+      res.f <<= 1;
+      res.e--;
+    }
+    res.f <<= 64 - 52 - 2;
+    res.e -= 64 - 52 - 2;
+    return res;
+  }
+
+  void normalizedBoundaries(DiyFp &minus, DiyFp &plus) const
+  {
+    DiyFp pl = DiyFp((f << 1) + 1, e - 1).normalizeBoundary();
+    DiyFp mi = (f == hiddenBit) ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    plus = pl;
+    minus = mi;
+  }
+};
+
+// Normalized 10^k for k = -348, -340, ..., 340
+const unsigned long long cachedPowersF[] = {
+  0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+  0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+  0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+  0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+  0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+  0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+  0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+  0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+  0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+  0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+  0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+  0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+  0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+  0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+  0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+  0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+  0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+  0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+  0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+  0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+  0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+  0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+  0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+  0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+  0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+  0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+  0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+  0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+  0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+const short cachedPowersE[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007,  -980,
+   -954,  -927,  -901,  -874,  -847,  -821,  -794,  -768,  -741,  -715,
+   -688,  -661,  -635,  -608,  -582,  -555,  -529,  -502,  -475,  -449,
+   -422,  -396,  -369,  -343,  -316,  -289,  -263,  -236,  -210,  -183,
+   -157,  -130,  -103,   -77,   -50,   -24,     3,    30,    56,    83,
+    109,   136,   162,   189,   216,   242,   269,   295,   322,   348,
+    375,   402,   428,   455,   481,   508,   534,   561,   588,   614,
+    641,   667,   694,   720,   747,   774,   800,   827,   853,   880,
+    907,   933,   960,   986,  1013,  1039,  1066
+};
+
+const unsigned int powersOfTen[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+    10000000, 100000000, 1000000000};
+
+DiyFp getCachedPower(int e, int &K)
+{
+  double dk = (-61 - e)*0.30102999566398114 + 347;  // log10(2)
+  int k = int(dk);
+  if (dk - k > 0.0)
+    k++;
+
+  unsigned index = unsigned((k >> 3) + 1);
+  K = -(-348 + int(index << 3));
+  return DiyFp(cachedPowersF[index], cachedPowersE[index]);
+}
+
+void grisuRound(char* buffer, int length, unsigned long long delta,
+                unsigned long long rest, unsigned long long tenKappa,
+                unsigned long long wpW)
+{
+  while (rest < wpW && delta - rest >= tenKappa &&
+         (rest + tenKappa < wpW || wpW - rest > rest + tenKappa - wpW))
+  {
+    buffer[length - 1]--;
+    rest += tenKappa;
+  }
+}
+
+int countDecimalDigits(unsigned int n)
+{
+  int digits = 1;
+  while (digits < 10 && n >= powersOfTen[digits])
+    digits++;
+  return digits;
+}
+
+void digitGen(const DiyFp &W, const DiyFp &Mp, unsigned long long delta,
+              char* buffer, int &length, int &K)
+{
+  const DiyFp one(1ULL << -Mp.e, Mp.e);
+  const DiyFp wpW = Mp - W;
+  unsigned int p1 = (unsigned int)(Mp.f >> -one.e);
+  unsigned long long p2 = Mp.f & (one.f - 1);
+  int kappa = countDecimalDigits(p1);
+  length = 0;
+
+  while (kappa > 0)
+  {
+    unsigned int d = p1/powersOfTen[kappa - 1];
+    p1 %= powersOfTen[kappa - 1];
+    if (d || length)
+      buffer[length++] = char('0' + d);
+    kappa--;
+    unsigned long long tmp = ((unsigned long long)p1 << -one.e) + p2;
+    if (tmp <= delta)
+    {
+      K += kappa;
+      grisuRound(buffer, length, delta, tmp,
+                 (unsigned long long)powersOfTen[kappa] << -one.e, wpW.f);
+      return;
+    }
+  }
+
+  for (;;)
+  {
+    p2 *= 10;
+    delta *= 10;
+    char d = char(p2 >> -one.e);
+    if (d || length)
+      buffer[length++] = char('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta)
+    {
+      K += kappa;
+      int index = -kappa;
+      grisuRound(buffer, length, delta, p2, one.f,
+                 wpW.f*(index < 10 ? powersOfTen[index] : 0));
+      return;
+    }
+  }
+}
+
+void grisu2(double value, char* buffer, int &length, int &K)
+{
+  const DiyFp v(value);
+  DiyFp wM, wP;
+  v.normalizedBoundaries(wM, wP);
+
+  const DiyFp cMK = getCachedPower(wP.e, K);
+  const DiyFp W = v.normalize()*cMK;
+  DiyFp Wp = wP*cMK;
+  DiyFp Wm = wM*cMK;
+  Wm.f++;
+  Wp.f--;
+  digitGen(W, Wp, Wp.f - Wm.f, buffer, length, K);
+}
+
+}
+
+std::size_t OutputWriter::formatDouble(double value, char* buffer)
+{
+  char* p = buffer;
+
+  if (std::isnan(value))
+  {
+    memcpy(p, "nan", 4);
+    return 3;
+  }
+
+  if (std::signbit(value))
+  {
+    *p++ = '-';
+    value = -value;
+  }
+
+  if (std::isinf(value))
+  {
+    memcpy(p, "inf", 4);
+    return p - buffer + 3;
+  }
+
+  if (value == 0.0)
+  {
+    *p++ = '0';
+    *p = '\0';
+    return p - buffer;
+  }
+
+  char digits[24];
+  int length, K;
+  grisu2(value, digits, length, K);
+
+  while (length > 1 && digits[length - 1] == '0')
+  {
+    length--;
+    K++;
+  }
+
+  // Decimal exponent of the first digit, formatted as "%.17g" would
+  int X = length + K - 1;
+
+  if (X < -4 || X >= 17)
+  {
+    *p++ = digits[0];
+    if (length > 1)
+    {
+      *p++ = '.';
+      memcpy(p, digits + 1, length - 1);
+      p += length - 1;
+    }
+    *p++ = 'e';
+    *p++ = X < 0 ? '-' : '+';
+    int exponent = X < 0 ? -X : X;
+    if (exponent >= 100)
+    {
+      *p++ = char('0' + exponent/100);
+      exponent %= 100;
+    }
+    *p++ = char('0' + exponent/10);
+    *p++ = char('0' + exponent%10);
+  }
+  else if (K >= 0)
+  {
+    memcpy(p, digits, length);
+    p += length;
+    memset(p, '0', K);
+    p += K;
+  }
+  else if (X >= 0)
+  {
+    memcpy(p, digits, X + 1);
+    p += X + 1;
+    *p++ = '.';
+    memcpy(p, digits + X + 1, length - X - 1);
+    p += length - X - 1;
+  }
+  else
+  {
+    *p++ = '0';
+    *p++ = '.';
+    memset(p, '0', -X - 1);
+    p += -X - 1;
+    memcpy(p, digits, length);
+    p += length;
+  }
+
+  *p = '\0';
+  return p - buffer;
+}
+
+OutputWriter::OutputWriter() :
+  format(F_CSV),
+  opened(false),
+  nColumns(0),
+  pipeline(NULL)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+  close();
+}
+
+void OutputWriter::open(std::string fileName, Format format, const std::vector<std::string> &headers)
+{
+  close();
+
+  this->format = format;
+  nColumns = headers.size();
+  file.open(fileName.c_str(), std::ios::out | std::ios::binary);
+  opened = true;
+
+  if (format == F_CSV)
+  {
+    buffer.clear();
+    buffer.reserve(bufferSize + 4096);
+    bufferedDate = boost::gregorian::date();
+    buffer += "Timestamp";
+    for (std::size_t c = 0; c < nColumns; c++)
+      buffer += ", " + headers[c];
+    buffer += '\n';
+  }
+  else
+  {
+    columnNames = headers;
+    times.clear();
+    columns.assign(nColumns, std::vector<double>());
+  }
+}
+
+bool OutputWriter::isOpen() const
+{
+  return opened;
+}
+
+void OutputWriter::appendTimestamp(boost::posix_time::ptime t)
+{
+  // Same text as to_simple_string(t), reusing the date text within a day
+  boost::posix_time::time_duration time = t.time_of_day();
+  if (t.is_special() || time.fractional_seconds() != 0)
+  {
+    buffer += boost::posix_time::to_simple_string(t);
+    return;
+  }
+
+  if (t.date() != bufferedDate)
+  {
+    bufferedDate = t.date();
+    bufferedDateText = boost::gregorian::to_simple_string(bufferedDate);
+  }
+  buffer += bufferedDateText;
+
+  long hours = time.hours();
+  long minutes = time.minutes();
+  long seconds = time.seconds();
+  char text[9] = {' ',
+      char('0' + hours/10), char('0' + hours%10), ':',
+      char('0' + minutes/10), char('0' + minutes%10), ':',
+      char('0' + seconds/10), char('0' + seconds%10)};
+  buffer.append(text, sizeof(text));
+}
+
+void OutputWriter::write(boost::posix_time::ptime t, const double* values)
+{
+  if (!opened)
+    return;
+
+  if (format == F_CSV)
+  {
+    appendTimestamp(t);
+    char text[32];
+    for (std::size_t c = 0; c < nColumns; c++)
+    {
+      buffer += ", ";
+      buffer.append(text, formatDouble(values[c], text));
+    }
+    buffer += '\n';
+
+    if (buffer.size() >= bufferSize)
+      flushBuffer();
+  }
+  else
+  {
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    times.push_back((t - epoch).total_seconds());
+    for (std::size_t c = 0; c < nColumns; c++)
+      columns[c].push_back(values[c]);
+  }
+}
+
+void OutputWriter::setPipeline(OutputPipeline* pipeline)
+{
+  this->pipeline = pipeline;
+}
+
+void OutputWriter::flushBuffer()
+{
+  if (pipeline)
+  {
+    // Hand the full buffer to the pipeline and continue in a new one
+    std::shared_ptr<std::string> text = std::make_shared<std::string>();
+    text->swap(buffer);
+    buffer.reserve(bufferSize + 4096);
+    std::ofstream* target = &file;
+    pipeline->submit([target, text]()
+    {
+      Kiva::Tracer::Scope trace("Write output");
+      target->write(text->data(), text->size());
+    });
+  }
+  else
+  {
+    Kiva::Tracer::Scope trace("Write output");
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+}
+
+void OutputWriter::writeBinary()
+{
+  Kiva::Tracer::Scope trace("Write output");
+  const unsigned int version = 1;
+  const unsigned int byteOrder = 0x01020304;
+  unsigned long long nRows = times.size();
+  unsigned long long nCols = nColumns;
+
+  file.write("KIVACOL1", 8);
+  file.write((const char*)&version, sizeof(version));
+  file.write((const char*)&byteOrder, sizeof(byteOrder));
+  file.write((const char*)&nRows, sizeof(nRows));
+  file.write((const char*)&nCols, sizeof(nCols));
+
+  unsigned long long position = 32;
+  for (std::size_t c = 0; c < nColumns; c++)
+  {
+    unsigned long long length = columnNames[c].size();
+    file.write((const char*)&length, sizeof(length));
+    file.write(columnNames[c].data(), length);
+    position += sizeof(length) + length;
+  }
+
+  const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  file.write(padding, (8 - position%8)%8);
+
+  if (nRows > 0)
+  {
+    file.write((const char*)&times[0], nRows*sizeof(long long));
+    for (std::size_t c = 0; c < nColumns; c++)
+      file.write((const char*)&columns[c][0], nRows*sizeof(double));
+  }
+
+  times.clear();
+  columns.clear();
+}
+
+void OutputWriter::close()
+{
+  if (!opened)
+    return;
+
+  if (format == F_CSV)
+    flushBuffer();
+  else
+    writeBinary();
+
+  if (pipeline)
+    pipeline->finish();
+
+  file.close();
+  opened = false;
+}
+
+#endif
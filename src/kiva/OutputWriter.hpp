@@ -0,0 +1,75 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef OUTPUTWRITER_H_
+#define OUTPUTWRITER_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/gregorian/gregorian.hpp>
+
+#include "OutputPipeline.hpp"
+
+// Writes output report rows, either as CSV text (buffered, with values in
+// the shortest form that reads back to the same double) or as a binary
+// columnar file written when the writer is closed:
+//
+//   "KIVACOL1", uint32 version, uint32 byte order mark (0x01020304),
+//   uint64 rows, uint64 columns, column names (uint64 length + characters),
+//   zero padding to a multiple of 8 bytes, int64 timestamps [s since
+//   1970-01-01 00:00:00], then each column as float64[rows]
+//
+// All values are in native byte order. When given a pipeline, full CSV
+// buffers are written to the file by the pipeline's workers.
+class OutputWriter
+{
+public:
+
+  enum Format
+  {
+    F_CSV,
+    F_BINARY
+  };
+
+  OutputWriter();
+  ~OutputWriter();
+
+  void open(std::string fileName, Format format, const std::vector<std::string> &headers);
+  bool isOpen() const;
+  void write(boost::posix_time::ptime t, const double* values);
+  void close();
+
+  void setPipeline(OutputPipeline* pipeline);
+
+  // Shortest decimal representation of value that reads back to the same
+  // double, in the style of printf's "%.17g"; returns the length written
+  // (at most 24 characters plus a terminating null)
+  static std::size_t formatDouble(double value, char* buffer);
+
+private:
+
+  std::ofstream file;
+  Format format;
+  bool opened;
+  std::size_t nColumns;
+  OutputPipeline* pipeline;
+
+  // CSV
+  std::string buffer;
+  boost::gregorian::date bufferedDate;
+  std::string bufferedDateText;
+  void appendTimestamp(boost::posix_time::ptime t);
+  void flushBuffer();
+
+  // Binary
+  std::vector<std::string> columnNames;
+  std::vector<long long> times;
+  std::vector<std::vector<double>> columns;
+  void writeBinary();
+
+};
+
+#endif /* OUTPUTWRITER_H_ */
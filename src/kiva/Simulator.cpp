@@ -7,12 +7,48 @@ using namespace Kiva;
 
 static const double PI = 4.0*atan(1.0);
 
-Simulator::Simulator(WeatherData &weatherData, Input &input, std::string outputFileName) :
-  weatherData(weatherData), input(input), ground(input.foundation,input.output.outputReport.outputMap)
+// One snapshot rendering worker per hardware thread (none without snapshots)
+static std::size_t getRenderWorkers(const Input &input)
 {
-  // set up output file
-  outputFile.open(outputFileName.c_str());
-  outputFile << "Timestamp" << printOutputHeaders() << std::endl;
+  if (input.output.outputAnimations.empty())
+    return 0;
+#ifdef HAVE_STD_THREAD
+  return std::max(std::thread::hardware_concurrency(), 1u);
+#else
+  return 0;
+#endif
+}
+
+Simulator::Simulator(WeatherData &weatherData, Input &input, std::string outputFileName,
+                     std::string restartFileName, InitializationCache* initializationCache,
+                     PhaseTimer* timer) :
+  input(input), weatherData(weatherData), ground(input.foundation,input.output.outputReport.outputMap),
+  renderPipeline(getRenderWorkers(input), 2*getRenderWorkers(input), "Render"),
+  timer(timer), restarted(!restartFileName.empty())
+{
+  ground.timer = timer;
+
+  int rank = 0;
+#ifdef ENABLE_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+  isRootProcess = rank == 0;
+
+  // Parareal integrates the whole simulation period from its start
+  if (restarted && input.simulationControl.parareal)
+  {
+    std::cerr << "Error: Parareal simulations cannot be restarted from a checkpoint." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // set up output file (written by the root process only)
+  outputValues.resize(input.output.outputReport.size());
+  outputAggregator.initialize(input.output.outputReport);
+  if (isRootProcess)
+  {
+    outputFile.setPipeline(&outputPipeline);
+    openOutputFile(outputFile, outputFileName);
+  }
 
   annualAverageDryBulbTemperature = weatherData.dryBulbTemp.getAverage();
 
@@ -27,22 +63,111 @@ Simulator::Simulator(WeatherData &weatherData, Input &input, std::string outputF
     ground.setNewBoundaryGeometry();
   }
 
+  unbuiltFoundation = input.foundation;
+
+#ifdef ENABLE_MPI
+  // With more than one process, each stores and calculates a slab of the
+  // domain, which is only possible for the explicit scheme (and so for
+  // initializations that do not use the implicit schemes)
+  int nProcs = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+  if (nProcs > 1)
+  {
+    if (input.simulationControl.parareal)
+    {
+      std::cerr << "Error: Parareal simulations cannot be divided among processes." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (input.initialization.initializationMethod == Initialization::IM_STEADY_STATE ||
+        input.initialization.implicitAccelPeriods > 0)
+    {
+      std::cerr << "Error: Simulations divided among processes cannot be initialized with the steady-state method or implicit acceleration periods." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (!ground.distribute(MPI_COMM_WORLD))
+  {
+    std::cerr << "Error: Only the explicit numerical scheme can be divided among processes." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
+
   ground.buildDomain();
 
+  initializeOutputReport();
+
   std::cout << "  X Cells: " << ground.nX << std::endl;
   std::cout << "  Y Cells: " << ground.nY << std::endl;
   std::cout << "  Z Cells: " << ground.nZ << std::endl;
   std::cout << "  Total Cells: " << ground.nX*ground.nY*ground.nZ << std::endl;
 
+  precomputeBoundaryConditions();
+
   // Initial Conditions
-  initializeConditions();
+  resumeTime = input.simulationControl.startTime;
+  if (restartFileName.empty())
+  {
+    // Steady state calculations are not initialized, so there is nothing to
+    // cache
+    if (initializationCache && input.foundation.numericalScheme != Foundation::NS_STEADY_STATE)
+    {
+      if (!readInitializationCache(*initializationCache))
+      {
+        initializeConditions();
+        writeInitializationCache(*initializationCache);
+      }
+    }
+    else
+      initializeConditions();
+  }
 
   initializePlots();
 
+  initializeFields();
+
+  initializeEnsemble(outputFileName);
+
+  if (!restartFileName.empty())
+    readCheckpoint(restartFileName);
+
 }
 
 Simulator::~Simulator() {
   outputFile.close();
+  for (std::size_t m = 0; m < ensembleOutputFiles.size(); m++)
+    ensembleOutputFiles[m].close();
+  outputPipeline.finish();
+  renderPipeline.finish();
+  for (std::size_t f = 0; f < fields.size(); f++)
+    fields[f].close();
+}
+
+void Simulator::initializeEnsemble(std::string outputFileName)
+{
+  std::size_t members = input.boundaries.indoorAirTemperatureEnsemble.size();
+
+  if (members == 0)
+    return;
+
+  // Ensemble members begin from the initialized conditions of the main
+  // simulation and share its domain
+  ground.setEnsembleSize(members);
+  ensembleBCs.resize(members + 1);
+
+  // Results for member n are written to "<output>-n.<ext>"
+  boost::filesystem::path outputPath(outputFileName);
+  for (std::size_t m = 0; m < members; m++)
+  {
+    boost::filesystem::path memberPath = outputPath.parent_path() /
+        (outputPath.stem().string() + "-" + std::to_string(m + 1) + outputPath.extension().string());
+    ensembleOutputFiles.emplace_back();
+    ensembleAggregators.push_back(outputAggregator);
+    if (isRootProcess)
+    {
+      ensembleOutputFiles[m].setPipeline(&outputPipeline);
+      openOutputFile(ensembleOutputFiles[m], memberPath.string());
+    }
+  }
 }
 
 void Simulator::initializeConditions()
@@ -52,6 +177,9 @@ void Simulator::initializeConditions()
 
   initPeriod = true;
 
+  warmupConvergenceMetric = 0.0;
+  warmupDaysSimulated = 0.0;
+
   if (input.foundation.numericalScheme != Foundation::NS_STEADY_STATE)  // Intialization not necessary for steady state calculations
   {
     std::cout << "Initializing Temperatures..." << std::endl;
@@ -70,6 +198,8 @@ void Simulator::initializeConditions()
     {
       Foundation::NumericalScheme tempNS = input.foundation.numericalScheme;
       input.foundation.numericalScheme = Foundation::NS_STEADY_STATE;
+      PhaseTimer::Scope scope(timer, PhaseTimer::PH_STEADY_STATE);
+      Tracer::Scope trace("Steady state initialization");
       updateBoundaryConditions(tInit);
       ground.calculate(bcs);
       printStatus(tInit);
@@ -77,7 +207,7 @@ void Simulator::initializeConditions()
     }
     else
     {
-      for (size_t i = 0; i < ground.nX; ++i)
+      for (size_t i = ground.iStoredBegin; i < ground.iStoredEnd; ++i)
       {
         for (size_t j = 0; j < ground.nY; ++j)
         {
@@ -93,6 +223,8 @@ void Simulator::initializeConditions()
     // Calculate implicit acceleration
     if (input.initialization.implicitAccelPeriods > 0)
     {
+      PhaseTimer::Scope scope(timer, PhaseTimer::PH_ACCELERATION);
+      Tracer::Scope trace("Implicit acceleration");
       boost::posix_time::ptime tAccelStart = input.simulationControl.startTime - warmupDuration - simulationTimestep - accelDuration; // [s] Acceleration start time
       boost::posix_time::ptime tAccelEnd = input.simulationControl.startTime - warmupDuration - simulationTimestep; // [s] Acceleration end time
 
@@ -113,17 +245,91 @@ void Simulator::initializeConditions()
     // Calculate warmup
     if (input.initialization.warmupDays > 0)
     {
+      PhaseTimer::Scope scope(timer, PhaseTimer::PH_WARMUP);
+      Tracer::Scope trace("Warmup");
 
       boost::posix_time::ptime tWarmupStart = input.simulationControl.startTime - warmupDuration; // [s] Acceleration start time
       boost::posix_time::ptime tWarmupEnd = input.simulationControl.startTime - simulationTimestep; // [s] Simulation end time
 
-      for (boost::posix_time::ptime t = tWarmupStart; t <= tWarmupEnd; t += simulationTimestep)
+      // Convergence is only checked a whole number of years before the start
+      // of the simulation, so an early end leaves the domain at the same
+      // time of year as the full warmup would. The state at each check is
+      // compared to the state one convergence interval earlier.
+      boost::posix_time::time_duration year = boost::posix_time::hours(365*24);
+      boost::posix_time::time_duration convergenceInterval = boost::posix_time::hours(input.initialization.warmupConvergenceInterval*24);
+      long checkYears = 0;
+      if (input.initialization.convergeWarmup && warmupDuration >= year + convergenceInterval)
+        checkYears = (warmupDuration - convergenceInterval).total_seconds()/year.total_seconds();
+      boost::posix_time::ptime tNextCheck = input.simulationControl.startTime - year*int(checkYears);
+      bool previousValuesSaved = false;
+
+      std::vector<double> previousValues;
+      if (checkYears > 0 && tNextCheck - convergenceInterval <= tWarmupStart)
+      {
+        previousValues = getWarmupConvergenceValues();
+        previousValuesSaved = true;
+      }
+
+      bool converged = false;
+      bool checked = false;
+      boost::posix_time::ptime t;
+
+      for (t = tWarmupStart; t <= tWarmupEnd; t += simulationTimestep)
       {
         updateBoundaryConditions(t);
         ground.calculate(bcs,simulationTimestep.total_seconds());
         printStatus(t);
+
+        if (checkYears == 0 || tNextCheck >= input.simulationControl.startTime)
+          continue;
+
+        boost::posix_time::ptime tNext = t + simulationTimestep;
+
+        if (!previousValuesSaved && tNext >= tNextCheck - convergenceInterval)
+        {
+          previousValues = getWarmupConvergenceValues();
+          previousValuesSaved = true;
+        }
+
+        if (tNext >= tNextCheck)
+        {
+          std::vector<double> values = getWarmupConvergenceValues();
+
+          warmupConvergenceMetric = 0.0;
+          for (std::size_t v = 0; v < values.size(); v++)
+            warmupConvergenceMetric = std::max(warmupConvergenceMetric, fabs(values[v] - previousValues[v]));
+
+          checked = true;
+          tNextCheck += year;
+          previousValuesSaved = tNext >= tNextCheck - convergenceInterval;
+          if (previousValuesSaved)
+            previousValues = values;
+
+          if (warmupConvergenceMetric < input.initialization.warmupConvergenceTolerance)
+          {
+            converged = true;
+            t += simulationTimestep;
+            break;
+          }
+        }
       }
 
+      warmupDaysSimulated = double((t - tWarmupStart).total_seconds())/(60.0*60.0*24.0);
+
+      if (input.initialization.convergeWarmup)
+      {
+        if (!checked)
+          std::cout << "  Warmup convergence was not checked (the warmup must be at least 365 days longer than the convergence interval)" << std::endl;
+        else
+        {
+          if (converged)
+            std::cout << "  Warmup converged after " << warmupDaysSimulated << " days";
+          else
+            std::cout << "  Warmup did not converge after " << warmupDaysSimulated << " days";
+
+          std::cout << " (maximum change: " << warmupConvergenceMetric << " K)" << std::endl;
+        }
+      }
     }
 
   }
@@ -193,6 +399,11 @@ void Simulator::initializePlots()
       }
     }
 
+    // A restarted simulation adds to the snapshots already in the directory
+    if (!restarted)
+      boost::filesystem::remove_all(input.output.outputAnimations[p].dir);
+    boost::filesystem::create_directory(input.output.outputAnimations[p].dir);
+
     plots.push_back(GroundPlot(input.output.outputAnimations[p],ground.domain,input.foundation.blocks));
 
     boost::posix_time::ptime startTime(input.output.outputAnimations[p].startDate,boost::posix_time::hours(0));;
@@ -204,39 +415,329 @@ void Simulator::initializePlots()
   }
 }
 
+void Simulator::initializeFields()
+{
+  for (std::size_t f = 0; f < input.output.outputFields.size(); f++)
+  {
+    if (!input.output.outputFields[f].startDateSet)
+      input.output.outputFields[f].startDate = input.simulationControl.startDate;
+
+    if (!input.output.outputFields[f].endDateSet)
+      input.output.outputFields[f].endDate = input.simulationControl.endDate;
+
+    fields.emplace_back(input.output.outputFields[f], ground.domain);
+
+    if (isRootProcess)
+      fields[f].open(ground.domain);
+
+    boost::posix_time::ptime startTime(input.output.outputFields[f].startDate,boost::posix_time::hours(0));
+    boost::posix_time::ptime endTime(input.output.outputFields[f].endDate + boost::gregorian::days(1));
+
+    fields[f].tStart = startTime;
+    fields[f].nextFrameTime = startTime;
+    fields[f].tEnd = endTime;
+  }
+}
+
 void Simulator::simulate()
 {
+  if (input.simulationControl.parareal)
+  {
+    simulateParareal();
+    return;
+  }
+
   std::cout << "Beginning Simulation..." << std::endl;
 
   boost::posix_time::ptime simStart = input.simulationControl.startTime;
   boost::posix_time::ptime simEnd(input.simulationControl.endDate + boost::gregorian::days(1));
   boost::posix_time::time_duration simDuration =  simEnd - simStart;
 
-  prevOutputTime = input.simulationControl.startTime - input.output.outputReport.minFrequency;
+  if (!restarted)
+    prevOutputTime = input.simulationControl.startTime - input.output.outputReport.minFrequency;
   double timestep = input.simulationControl.timestep.total_seconds();
 
-  for (boost::posix_time::ptime t = simStart; t < simEnd; t = t + input.simulationControl.timestep)
+  long checkpointInterval = checkpointFrequency.total_seconds();
+
+  for (boost::posix_time::ptime t = resumeTime; t < simEnd; t = t + input.simulationControl.timestep)
   {
+    Tracer::Scope trace("Timestep");
+    if (timer)
+      timer->beginStep();
 
     percentComplete = round(double((t-simStart).total_seconds())/double(simDuration.total_seconds())*1000)/10.0;
-    updateBoundaryConditions(t);
-    ground.calculate(bcs,timestep);
+    {
+      PhaseTimer::Scope scope(timer, PhaseTimer::PH_BOUNDARY_CONDITIONS);
+      updateBoundaryConditions(t);
+    }
+    if (ensembleBCs.size() > 0)
+    {
+      long n = getBoundaryConditionIndex(t);
+      for (std::size_t m = 0; m < ensembleOutputFiles.size(); m++)
+      {
+        ensembleBCs[m] = bcs;
+        if (n >= 0)
+          ensembleBCs[m].indoorTemp = ensembleIndoorTempTable[n*ensembleOutputFiles.size() + m];
+        else
+          ensembleBCs[m].indoorTemp = input.boundaries.indoorAirTemperatureEnsemble[m].data.getValue(t);
+      }
+      ensembleBCs.back() = bcs;
+      ground.calculateEnsemble(ensembleBCs,timestep);
+    }
+    else
+    {
+      ground.calculate(bcs,timestep);
+    }
     ground.calculateSurfaceAverages();
-    plot(t);
+    {
+      PhaseTimer::Scope scope(timer, PhaseTimer::PH_PLOT);
+      Tracer::Scope trace("Plot");
+      plot(t);
+    }
     printStatus(t);
 
-    if (t - prevOutputTime >= input.output.outputReport.minFrequency)
+    if (timer)
+      timer->start(PhaseTimer::PH_OUTPUT);
+    writeFields(t);
+
+    if (input.output.outputReport.interval != OutputReport::I_TIMESTEP ||
+        t - prevOutputTime >= input.output.outputReport.minFrequency)
     {
-      outputFile << to_simple_string(t) << printOutputLine() << std::endl;
+      getOutputValues(ground, outputValues.data());
+      writeOutput(outputFile, outputAggregator, t, timestep, outputValues.data());
+      for (std::size_t m = 0; m < ensembleOutputFiles.size(); m++)
+      {
+        getOutputValues(ground, outputValues.data(), m);
+        writeOutput(ensembleOutputFiles[m], ensembleAggregators[m], t, timestep, outputValues.data());
+      }
       prevOutputTime = t;
     }
 
+    boost::posix_time::ptime tNext = t + input.simulationControl.timestep;
+    if (!checkpointFileName.empty() && checkpointInterval > 0 && tNext < simEnd &&
+        (tNext - simStart).total_seconds() % checkpointInterval == 0)
+      writeCheckpoint(tNext);
+
+    if (timer)
+    {
+      timer->stop(PhaseTimer::PH_OUTPUT);
+      timer->endStep();
+    }
+
   }
 
+  finishOutput(outputFile, outputAggregator);
+  for (std::size_t m = 0; m < ensembleOutputFiles.size(); m++)
+    finishOutput(ensembleOutputFiles[m], ensembleAggregators[m]);
+
+  // Written after the aggregators complete their last intervals, so a
+  // restarted simulation does not write them again
+  if (!checkpointFileName.empty())
+    writeCheckpoint(std::max(simEnd, resumeTime));
+
   std::cout << "  " << simEnd - input.simulationControl.timestep << " (100%)" << std::endl;
 
 }
 
+void Simulator::simulateParareal()
+{
+  /* Parareal time-parallel integration
+   *
+   * The simulation period is divided into time slices. A coarse propagator
+   * (implicit scheme with large timesteps) runs serially across the slices
+   * while the fine propagator (user-defined scheme and timestep) runs on
+   * each slice in parallel. The slice initial conditions are corrected
+   * each iteration until they stop changing:
+   *
+   *   U[n+1] = G(U_new[n]) + F(U_old[n]) - G(U_old[n])
+   */
+  std::cout << "Beginning Simulation (Parareal)..." << std::endl;
+
+  if (plots.size() > 0)
+    std::cerr << "Warning: Output snapshots are not created when using Parareal." << std::endl;
+
+  if (fields.size() > 0)
+    std::cerr << "Warning: Output fields are not written when using Parareal." << std::endl;
+
+  if (!checkpointFileName.empty())
+    std::cerr << "Warning: Checkpoints are not written when using Parareal." << std::endl;
+
+  if (ensembleOutputFiles.size() > 0)
+    std::cerr << "Warning: Ensemble members are not simulated when using Parareal." << std::endl;
+
+  boost::posix_time::ptime simStart = input.simulationControl.startTime;
+  boost::posix_time::ptime simEnd(input.simulationControl.endDate + boost::gregorian::days(1));
+  boost::posix_time::time_duration simulationTimestep = input.simulationControl.timestep;
+  boost::posix_time::time_duration coarseTimestep = input.simulationControl.pararealCoarseTimestep;
+  double timestep = simulationTimestep.total_seconds();
+
+  std::size_t nSteps = 0;
+  for (boost::posix_time::ptime t = simStart; t < simEnd; t = t + simulationTimestep)
+    nSteps++;
+
+  // Determine output timesteps in the same way as the serial simulation
+  // (aggregated reports use every timestep)
+  bool aggregate = input.output.outputReport.interval != OutputReport::I_TIMESTEP;
+  std::vector<bool> isOutputStep(nSteps, false);
+  prevOutputTime = simStart - input.output.outputReport.minFrequency;
+  for (std::size_t s = 0; s < nSteps; s++)
+  {
+    boost::posix_time::ptime t = simStart + simulationTimestep*s;
+    if (aggregate || t - prevOutputTime >= input.output.outputReport.minFrequency)
+    {
+      isOutputStep[s] = true;
+      prevOutputTime = t;
+    }
+  }
+
+  std::size_t nSlices = input.simulationControl.pararealSlices;
+  if (nSlices == 0)
+  {
+#ifdef _OPENMP
+    nSlices = omp_get_max_threads();
+#else
+    nSlices = 1;
+#endif
+  }
+  nSlices = std::max(std::min(nSlices, nSteps), std::size_t(1));
+
+  std::vector<std::size_t> sliceStart(nSlices + 1);
+  for (std::size_t n = 0; n <= nSlices; n++)
+    sliceStart[n] = n*nSteps/nSlices;
+
+  // Each slice needs its own ground instance (and foundation). These are
+  // built serially since LIS memory management is not thread safe.
+  std::deque<Foundation> fineFoundations(nSlices, unbuiltFoundation);
+  std::deque<Ground> fineGrounds;
+  for (std::size_t n = 0; n < nSlices; n++)
+  {
+    fineGrounds.emplace_back(fineFoundations[n], input.output.outputReport.outputMap);
+    fineGrounds[n].buildDomain();
+  }
+
+  Foundation coarseFoundation = unbuiltFoundation;
+  coarseFoundation.numericalScheme = Foundation::NS_IMPLICIT;
+  Ground coarse(coarseFoundation);
+  coarse.buildDomain();
+
+  // Fine propagators using the LIS solvers must run serially
+  bool parallelFine = unbuiltFoundation.numericalScheme == Foundation::NS_ADE ||
+                      unbuiltFoundation.numericalScheme == Foundation::NS_EXPLICIT ||
+                      unbuiltFoundation.numericalScheme == Foundation::NS_ADI;
+
+  typedef std::vector<std::vector<std::vector<StorageType>>> Field;
+
+  std::vector<Field> U(nSlices + 1);
+  std::vector<Field> G(nSlices);
+  std::vector<Field> F(nSlices);
+  std::size_t nOutputs = outputValues.size();
+  std::vector<std::vector<boost::posix_time::ptime>> sliceOutputTimes(nSlices);
+  std::vector<std::vector<double>> sliceOutputValues(nSlices);
+
+  U[0] = ground.TOld;
+
+  BoundaryConditions coarseBCs;
+
+  auto propagateCoarse = [&](std::size_t n, const Field &T) -> Field
+  {
+    coarse.TOld = T;
+    boost::posix_time::ptime t = simStart + simulationTimestep*sliceStart[n];
+    boost::posix_time::ptime tEnd = simStart + simulationTimestep*sliceStart[n + 1];
+    while (t < tEnd)
+    {
+      boost::posix_time::time_duration h = std::min(coarseTimestep, tEnd - t);
+      updateBoundaryConditions(t, coarseBCs);
+      coarse.calculate(coarseBCs, h.total_seconds());
+      t += h;
+    }
+    return coarse.TOld;
+  };
+
+  // Initial coarse prediction
+  for (std::size_t n = 0; n < nSlices; n++)
+  {
+    G[n] = propagateCoarse(n, U[n]);
+    U[n + 1] = G[n];
+  }
+
+  std::size_t maxIterations = std::min(std::size_t(input.simulationControl.pararealMaxIterations), nSlices);
+
+  for (std::size_t iteration = 1; iteration <= maxIterations; iteration++)
+  {
+    // Fine propagation (slices before iteration - 1 have not changed since
+    // the previous iteration)
+    #pragma omp parallel for schedule(dynamic) if(parallelFine)
+    for (long n = 0; n < long(nSlices); n++)
+    {
+      if (std::size_t(n) + 1 < iteration)
+        continue;
+
+      Ground &fine = fineGrounds[n];
+      BoundaryConditions fineBCs;
+      fine.TOld = U[n];
+      sliceOutputTimes[n].clear();
+      sliceOutputValues[n].clear();
+
+      for (std::size_t s = sliceStart[n]; s < sliceStart[n + 1]; s++)
+      {
+        boost::posix_time::ptime t = simStart + simulationTimestep*s;
+        updateBoundaryConditions(t, fineBCs);
+        fine.calculate(fineBCs, timestep);
+
+        if (isOutputStep[s])
+        {
+          fine.calculateSurfaceAverages();
+          sliceOutputTimes[n].push_back(t);
+          sliceOutputValues[n].resize(sliceOutputValues[n].size() + nOutputs);
+          getOutputValues(fine, sliceOutputValues[n].data() + sliceOutputValues[n].size() - nOutputs);
+        }
+      }
+
+      F[n] = fine.TOld;
+    }
+
+    // Serial coarse correction
+    double maxChange = 0.0;
+    for (std::size_t n = 0; n < nSlices; n++)
+    {
+      Field GNew = propagateCoarse(n, U[n]);
+      Field &UNext = U[n + 1];
+
+      for (size_t i = 0; i < ground.nX; ++i)
+      {
+        for (size_t j = 0; j < ground.nY; ++j)
+        {
+          for (size_t k = 0; k < ground.nZ; ++k)
+          {
+            double T = GNew[i][j][k] + F[n][i][j][k] - G[n][i][j][k];
+            maxChange = std::max(maxChange, fabs(T - UNext[i][j][k]));
+            UNext[i][j][k] = T;
+          }
+        }
+      }
+      G[n] = GNew;
+    }
+
+    std::cout << "  Iteration " << iteration << ": maximum change " << maxChange << " K" << std::endl;
+
+    if (maxChange < input.simulationControl.pararealTolerance)
+      break;
+  }
+
+  for (std::size_t n = 0; n < nSlices; n++)
+  {
+    for (std::size_t l = 0; l < sliceOutputTimes[n].size(); l++)
+      writeOutput(outputFile, outputAggregator, sliceOutputTimes[n][l], timestep,
+                  sliceOutputValues[n].data() + l*nOutputs);
+  }
+  finishOutput(outputFile, outputAggregator);
+
+  ground.TOld = U[nSlices];
+  ground.TNew = U[nSlices];
+
+  std::cout << "  " << simEnd - simulationTimestep << " (100%)" << std::endl;
+}
+
 void Simulator::plot(boost::posix_time::ptime t)
 {
   for (std::size_t p = 0; p < plots.size(); p++)
@@ -247,42 +748,57 @@ void Simulator::plot(boost::posix_time::ptime t)
 
       std::size_t nI =  plots[p].iMax - plots[p].iMin + 1;
       std::size_t nJ = plots[p].jMax - plots[p].jMin + 1;
+      std::size_t nK = plots[p].kMax - plots[p].kMin + 1;
+
+      // Gather the slice into a pooled buffer to be rendered by the render
+      // pipeline (frame numbers are assigned here, so they stay in order).
+      // Other processes only send their cells of the slice.
+      std::shared_ptr<std::vector<double>> values =
+          std::make_shared<std::vector<double>>();
+      if (isRootProcess)
+      {
+        *values = renderPipeline.getBuffer();
+        values->resize(nI*nJ*nK);
+      }
+      double *Q = values->empty() ? NULL : &(*values)[0];
 
-      for(size_t k = plots[p].kMin; k <= plots[p].kMax; k++)
+      if (input.output.outputAnimations[p].plotType == OutputAnimation::P_TEMP)
       {
-        for(size_t j = plots[p].jMin; j <= plots[p].jMax; j++)
+        ground.getTemperatures(plots[p].iMin, plots[p].iMax,
+                               plots[p].jMin, plots[p].jMax,
+                               plots[p].kMin, plots[p].kMax, Q);
+
+        for (std::size_t index = 0; index < values->size(); index++)
         {
-          for(size_t i = plots[p].iMin; i <= plots[p].iMax; i++)
-          {
-            std::size_t index = (i-plots[p].iMin)+nI*(j-plots[p].jMin)+nI*nJ*(k-plots[p].kMin);
-            if (input.output.outputAnimations[p].plotType == OutputAnimation::P_TEMP)
-            {
-              if (input.output.outputAnimations[p].outputUnits == OutputAnimation::IP)
-                plots[p].TDat.a[index] = (ground.TNew[i][j][k] - 273.15)*9/5 + 32.0;
-              else
-                plots[p].TDat.a[index] = ground.TNew[i][j][k] - 273.15;
-            }
-            else
-            {
-              double du = plots[p].distanceUnitConversion;
-              std::vector<double> Qflux = ground.calculateHeatFlux(i,j,k);
-              double Qx = Qflux[0];
-              double Qy = Qflux[1];
-              double Qz = Qflux[2];
-              double Qmag = sqrt(Qx*Qx + Qy*Qy + Qz*Qz);
-
-              if (input.output.outputAnimations[p].fluxDir == OutputAnimation::D_M)
-                plots[p].TDat.a[index] = Qmag/(du*du);
-              else if (input.output.outputAnimations[p].fluxDir == OutputAnimation::D_X)
-                plots[p].TDat.a[index] = Qx/(du*du);
-              else if (input.output.outputAnimations[p].fluxDir == OutputAnimation::D_Y)
-                plots[p].TDat.a[index] = Qy/(du*du);
-              else if (input.output.outputAnimations[p].fluxDir == OutputAnimation::D_Z)
-                plots[p].TDat.a[index] = Qz/(du*du);
-            }
-          }
+          if (input.output.outputAnimations[p].outputUnits == OutputAnimation::IP)
+            (*values)[index] = ((*values)[index] - 273.15)*9/5 + 32.0;
+          else
+            (*values)[index] = (*values)[index] - 273.15;
         }
       }
+      else
+      {
+        // Heat flux of the plotted cells only, written directly into the
+        // buffer
+        OutputAnimation::FluxDir fluxDir = input.output.outputAnimations[p].fluxDir;
+        ground.calculateHeatFlux(plots[p].iMin, plots[p].iMax,
+                                 plots[p].jMin, plots[p].jMax,
+                                 plots[p].kMin, plots[p].kMax,
+                                 fluxDir == OutputAnimation::D_X ? Q : NULL,
+                                 fluxDir == OutputAnimation::D_Y ? Q : NULL,
+                                 fluxDir == OutputAnimation::D_Z ? Q : NULL,
+                                 fluxDir == OutputAnimation::D_M ? Q : NULL);
+
+        double du = plots[p].distanceUnitConversion;
+        for (std::size_t index = 0; index < values->size(); index++)
+          (*values)[index] /= du*du;
+      }
+
+      if (!isRootProcess)
+      {
+        plots[p].beginFrame();
+        continue;
+      }
 
       /*
       std::ofstream output;
@@ -319,11 +835,266 @@ void Simulator::plot(boost::posix_time::ptime t)
       }
       output.close();*/
 
-      plots[p].createFrame(timeStamp);
+      int frame = plots[p].beginFrame();
+      GroundPlot *groundPlot = &plots[p];
+      OutputPipeline *pipeline = &renderPipeline;
+      renderPipeline.submit([groundPlot, pipeline, values, timeStamp, frame]()
+      {
+        groundPlot->createFrame(timeStamp, *values, frame);
+        pipeline->releaseBuffer(std::move(*values));
+      });
+    }
+  }
+}
+
+void Simulator::writeFields(boost::posix_time::ptime t)
+{
+  for (std::size_t f = 0; f < fields.size(); f++)
+  {
+    if (fields[f].makeNewFrame(t))
+    {
+      fields[f].beginFrame();
+
+      std::size_t nI = fields[f].iMax - fields[f].iMin + 1;
+      std::size_t nJ = fields[f].jMax - fields[f].jMin + 1;
+      std::size_t nK = fields[f].kMax - fields[f].kMin + 1;
+
+      // Other processes only send their cells of the field
+      if (!isRootProcess)
+      {
+        ground.getTemperatures(fields[f].iMin, fields[f].iMax,
+                               fields[f].jMin, fields[f].jMax,
+                               fields[f].kMin, fields[f].kMax, NULL);
+        continue;
+      }
+
+      std::shared_ptr<std::vector<double>> values =
+          std::make_shared<std::vector<double>>(outputPipeline.getBuffer());
+      values->resize(nI*nJ*nK);
+
+      ground.getTemperatures(fields[f].iMin, fields[f].iMax,
+                             fields[f].jMin, fields[f].jMax,
+                             fields[f].kMin, fields[f].kMax, &(*values)[0]);
+
+      FieldWriter *field = &fields[f];
+      OutputPipeline *pipeline = &outputPipeline;
+      outputPipeline.submit([field, pipeline, values, t]()
+      {
+        field->writeFrame(t, *values);
+        pipeline->releaseBuffer(std::move(*values));
+      });
     }
   }
 }
 
+// Sets the stored columns of a temperature field from values ordered
+// k + nZ*j + nZ*nY*(i - iFirst) (see Ground::gatherField)
+static void unflattenField(const std::vector<double> &values, std::size_t iFirst,
+                           std::vector<std::vector<std::vector<StorageType>>> &T)
+{
+  std::size_t index = 0;
+  for (std::size_t i = iFirst; index < values.size(); i++)
+    for (std::size_t j = 0; j < T[i].size(); j++)
+      for (std::size_t k = 0; k < T[i][j].size(); k++)
+        T[i][j][k] = StorageType(values[index++]);
+}
+
+void Simulator::saveSolution(Checkpoint &checkpoint, long member)
+{
+  // Temperatures are gathered from every process, but only written by the
+  // root process
+  std::vector<double> TOld = ground.gatherField(member < 0 ? ground.TOld : ground.ensembleTOld[member]);
+  std::vector<double> TNew = ground.gatherField(member < 0 ? ground.TNew : ground.ensembleTNew[member]);
+
+  if (!isRootProcess)
+    return;
+
+  checkpoint.writeArray(TOld);
+  checkpoint.writeArray(TNew);
+  checkpoint.writeArray(ground.getSolverGuess(member));
+}
+
+void Simulator::restoreSolution(Checkpoint &checkpoint, long member)
+{
+  std::size_t nCells = ground.nX*ground.nY*ground.nZ;
+
+  // Each process reads only the columns it stores
+  std::size_t nYZ = ground.nY*ground.nZ;
+  std::size_t begin = ground.iStoredBegin*nYZ;
+  std::size_t count = (ground.iStoredEnd - ground.iStoredBegin)*nYZ;
+
+  // Distributed simulations do not use (or save) a solver guess
+  std::vector<double> TOld, TNew, guess;
+  std::size_t nTOld = checkpoint.readArray(TOld, begin, count);
+  std::size_t nTNew = checkpoint.readArray(TNew, begin, count);
+  std::size_t nGuess = checkpoint.readArray(guess, 0, ground.isDistributed() ? 0 : nCells);
+  if (nTOld != nCells || nTNew != nCells || (nGuess != nCells && nGuess != 0))
+  {
+    std::cerr << "Error: Checkpoint temperatures do not match the input." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  unflattenField(TOld, ground.iStoredBegin, member < 0 ? ground.TOld : ground.ensembleTOld[member]);
+  unflattenField(TNew, ground.iStoredBegin, member < 0 ? ground.TNew : ground.ensembleTNew[member]);
+  ground.setSolverGuess(guess, member);
+}
+
+std::string Simulator::getInitializationKey(const InitializationCache &cache)
+{
+  std::ostringstream key;
+  key << "Kiva: " << cache.getVersion() << "\n";
+  key << "Checkpoint Version: " << Checkpoint::version << "\n";
+  key << "Storage Size: " << sizeof(StorageType) << "\n";
+  key << "Weather: " << std::hex << weatherData.hash << "\n";
+  if (input.boundaries.indoorTemperatureMethod == Boundaries::ITM_FILE)
+    key << "Indoor Air Temperature Data: " << std::hex << input.boundaries.indoorAirTemperatureFile.hash << "\n";
+  key << input.initializationKey;
+  return key.str();
+}
+
+bool Simulator::readInitializationCache(InitializationCache &cache)
+{
+  std::string key = getInitializationKey(cache);
+
+  Checkpoint checkpoint;
+  if (!cache.contains(key) || !checkpoint.open(cache.getFileName(key), false))
+    return false;
+
+  // Different keys with the same hash
+  if (checkpoint.readString() != key)
+    return false;
+
+  restoreSolution(checkpoint);
+  warmupConvergenceMetric = checkpoint.readDouble();
+  warmupDaysSimulated = checkpoint.readDouble();
+  checkpoint.close();
+
+  cache.touch(key);
+
+  prevStatusUpdate = boost::posix_time::second_clock::local_time();
+  initPeriod = false;
+
+  std::cout << "Initialized temperatures loaded from cache (" << cache.getFileName(key) << ")" << std::endl;
+
+  return true;
+}
+
+void Simulator::writeInitializationCache(InitializationCache &cache)
+{
+  // The cache is only an optimization, so failures to write it are ignored
+  std::string key = getInitializationKey(cache);
+
+  // Written by the root process (every process takes part in saveSolution)
+  Checkpoint checkpoint;
+  if (isRootProcess)
+  {
+    checkpoint.create(cache.getFileName(key), false);
+    checkpoint.writeString(key);
+  }
+  saveSolution(checkpoint);
+
+  if (!isRootProcess)
+    return;
+
+  checkpoint.writeDouble(warmupConvergenceMetric);
+  checkpoint.writeDouble(warmupDaysSimulated);
+  if (checkpoint.commit())
+    cache.trim(key);
+}
+
+void Simulator::writeCheckpoint(boost::posix_time::ptime t)
+{
+  Tracer::Scope trace("Write checkpoint");
+
+  std::size_t members = ground.getEnsembleSize();
+
+  // Written by the root process (every process takes part in saveSolution)
+  Checkpoint checkpoint;
+  if (isRootProcess)
+  {
+    checkpoint.create(checkpointFileName);
+    checkpoint.writeTime(t);
+
+    // Temperatures and iterative solver guesses of the main solution and
+    // each ensemble member. (The ADE sweeps start from the old temperatures
+    // each timestep, so they are not part of the state.)
+    checkpoint.writeSize(ground.nX);
+    checkpoint.writeSize(ground.nY);
+    checkpoint.writeSize(ground.nZ);
+    checkpoint.writeSize(members);
+  }
+  for (long m = -1; m < long(members); m++)
+    saveSolution(checkpoint, m);
+
+  if (!isRootProcess)
+    return;
+
+  // Output
+  checkpoint.writeTime(prevOutputTime);
+  outputAggregator.save(checkpoint);
+  for (std::size_t m = 0; m < members; m++)
+    ensembleAggregators[m].save(checkpoint);
+
+  checkpoint.writeSize(plots.size());
+  for (std::size_t p = 0; p < plots.size(); p++)
+  {
+    checkpoint.writeTime(plots[p].nextPlotTime);
+    checkpoint.writeLong(plots[p].frameNumber);
+  }
+
+  checkpoint.writeSize(fields.size());
+  for (std::size_t f = 0; f < fields.size(); f++)
+    checkpoint.writeTime(fields[f].nextFrameTime);
+
+  checkpoint.commit();
+}
+
+void Simulator::readCheckpoint(std::string fileName)
+{
+  std::size_t members = ground.getEnsembleSize();
+
+  Checkpoint checkpoint;
+  checkpoint.open(fileName);
+  resumeTime = checkpoint.readTime();
+
+  boost::posix_time::ptime simEnd(input.simulationControl.endDate + boost::gregorian::days(1));
+  if (resumeTime < input.simulationControl.startTime || resumeTime > simEnd)
+  {
+    std::cerr << "Error: Checkpoint time (" << resumeTime << ") is not within the simulation period." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  checkpoint.checkSize(ground.nX, "cells in the X direction");
+  checkpoint.checkSize(ground.nY, "cells in the Y direction");
+  checkpoint.checkSize(ground.nZ, "cells in the Z direction");
+  checkpoint.checkSize(members, "ensemble members");
+
+  for (long m = -1; m < long(members); m++)
+    restoreSolution(checkpoint, m);
+
+  prevOutputTime = checkpoint.readTime();
+  outputAggregator.restore(checkpoint);
+  for (std::size_t m = 0; m < members; m++)
+    ensembleAggregators[m].restore(checkpoint);
+
+  checkpoint.checkSize(plots.size(), "output snapshots");
+  for (std::size_t p = 0; p < plots.size(); p++)
+  {
+    plots[p].nextPlotTime = checkpoint.readTime();
+    plots[p].frameNumber = int(checkpoint.readLong());
+  }
+
+  checkpoint.checkSize(fields.size(), "output fields");
+  for (std::size_t f = 0; f < fields.size(); f++)
+    fields[f].nextFrameTime = checkpoint.readTime();
+
+  checkpoint.close();
+
+  initPeriod = false;
+  prevStatusUpdate = boost::posix_time::second_clock::local_time();
+
+  std::cout << "Resuming from checkpoint at " << resumeTime << std::endl;
+}
+
 void Simulator::printStatus(boost::posix_time::ptime t)
 {
   boost::posix_time::ptime currentTime = boost::posix_time::second_clock::local_time();
@@ -377,17 +1148,155 @@ double Simulator::getDeepGroundTemperature()
     return input.foundation.deepGroundTemperature;
 }
 
+std::vector<double> Simulator::getWarmupConvergenceValues()
+{
+  // Values monitored for warmup convergence: the heat capacity weighted
+  // average temperature of the domain (a measure of stored energy) and the
+  // area weighted average temperatures of the foundation's interior surfaces.
+  // These do not depend on the output report, so the report cannot change
+  // when the warmup ends.
+
+  // Sums over the cells of the local slab: CT and C, then TA and A of each
+  // surface type
+  std::vector<double> sums;
+
+  double CT = 0.0;
+  double C = 0.0;
+
+  for (size_t i = ground.iBegin; i < ground.iEnd; ++i)
+  {
+    for (size_t j = 0; j < ground.nY; ++j)
+    {
+      for (size_t k = 0; k < ground.nZ; ++k)
+      {
+        Cell& cell = ground.domain.cell[i][j][k];
+        if (cell.cellType != Cell::INTERIOR_AIR &&
+            cell.cellType != Cell::EXTERIOR_AIR)
+        {
+          double capacity = cell.density*cell.specificHeat*cell.volume;
+          CT += capacity*ground.TOld[i][j][k];
+          C += capacity;
+        }
+      }
+    }
+  }
+
+  sums.push_back(CT);
+  sums.push_back(C);
+
+  const Surface::SurfaceType foundationSurfaces[] =
+      {Surface::ST_SLAB_CORE, Surface::ST_SLAB_PERIM, Surface::ST_WALL_INT};
+
+  for (auto surfaceType : foundationSurfaces)
+  {
+    double TA = 0.0;
+    double A = 0.0;
+
+    for (auto& surface : ground.foundation.surfaces)
+    {
+      if (surface.type != surfaceType)
+        continue;
+
+      for (auto& index : surface.indices)
+      {
+        std::size_t i = boost::get<0>(index);
+        std::size_t j = boost::get<1>(index);
+        std::size_t k = boost::get<2>(index);
+        if (i < ground.iBegin || i >= ground.iEnd)
+          continue;
+        double area = ground.domain.cell[i][j][k].area;
+        TA += area*ground.TOld[i][j][k];
+        A += area;
+      }
+    }
+
+    sums.push_back(TA);
+    sums.push_back(A);
+  }
+
+#ifdef ENABLE_MPI
+  if (ground.isDistributed())
+  {
+    std::vector<double> globalSums(sums.size());
+    MPI_Allreduce(&sums[0], &globalSums[0], int(sums.size()), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    sums = globalSums;
+  }
+#endif
+
+  std::vector<double> values;
+  for (std::size_t v = 0; v < sums.size(); v += 2)
+  {
+    if (sums[v + 1] > 0.0)
+      values.push_back(sums[v]/sums[v + 1]);
+  }
+
+  return values;
+}
+
 void Simulator::updateBoundaryConditions(boost::posix_time::ptime t)
+{
+  updateBoundaryConditions(t, bcs);
+}
+
+void Simulator::updateBoundaryConditions(boost::posix_time::ptime t, BoundaryConditions &boundaryConditions)
+{
+  long n = getBoundaryConditionIndex(t);
+  if (n >= 0)
+    boundaryConditions = bcTable[n];
+  else
+    calculateBoundaryConditions(t, boundaryConditions);
+}
+
+void Simulator::precomputeBoundaryConditions()
+{
+  boost::posix_time::time_duration warmupDuration = boost::posix_time::hours(input.initialization.warmupDays*24);
+  boost::posix_time::ptime simEnd(input.simulationControl.endDate + boost::gregorian::days(1));
+
+  bcTableStart = input.simulationControl.startTime - warmupDuration;
+  bcTableStep = input.simulationControl.timestep;
+
+  long step = bcTableStep.total_seconds();
+  long duration = (simEnd - bcTableStart).total_seconds();
+  std::size_t nSteps = step > 0 && duration > 0 ? (duration + step - 1)/step : 0;
+  std::size_t nMembers = input.boundaries.indoorAirTemperatureEnsemble.size();
+
+  bcTable.resize(nSteps);
+  ensembleIndoorTempTable.resize(nSteps*nMembers);
+
+  #pragma omp parallel for
+  for (long n = 0; n < long(nSteps); n++)
+  {
+    boost::posix_time::ptime t = bcTableStart + bcTableStep*n;
+    calculateBoundaryConditions(t, bcTable[n]);
+    for (std::size_t m = 0; m < nMembers; m++)
+      ensembleIndoorTempTable[n*nMembers + m] = input.boundaries.indoorAirTemperatureEnsemble[m].data.getValue(t);
+  }
+}
+
+long Simulator::getBoundaryConditionIndex(boost::posix_time::ptime t)
+{
+  if (bcTable.empty() || t < bcTableStart)
+    return -1;
+
+  long seconds = (t - bcTableStart).total_seconds();
+  long step = bcTableStep.total_seconds();
+  if (seconds % step != 0 || std::size_t(seconds/step) >= bcTable.size())
+    return -1;
+
+  return seconds/step;
+}
+
+void Simulator::calculateBoundaryConditions(boost::posix_time::ptime t, BoundaryConditions &boundaryConditions)
 {
   if (input.boundaries.indoorTemperatureMethod == Boundaries::ITM_FILE)
-    bcs.indoorTemp = input.boundaries.indoorAirTemperatureFile.data.getValue(t);
+    boundaryConditions.indoorTemp = input.boundaries.indoorAirTemperatureFile.data.getValue(t);
   else // Boundaries::ITM_CONSTANT_TEMPERATURE)
-    bcs.indoorTemp = input.boundaries.indoorAirTemperature;
+    boundaryConditions.indoorTemp = input.boundaries.indoorAirTemperature;
 
   if (input.boundaries.outdoorTemperatureMethod == Boundaries::OTM_WEATHER_FILE)
-    bcs.outdoorTemp = weatherData.dryBulbTemp.getValue(t);
+    boundaryConditions.outdoorTemp = weatherData.dryBulbTemp.getValue(t);
   else // Boundaries::OTM_CONSTANT_TEMPERATURE)
-    bcs.outdoorTemp =  input.boundaries.outdoorDryBulbTemperature;
+    boundaryConditions.outdoorTemp =  input.boundaries.outdoorDryBulbTemperature;
 
   double vWS = weatherData.windSpeed.getValue(t);
   const double deltaWS = 270;  // [m]
@@ -398,54 +1307,105 @@ void Simulator::updateBoundaryConditions(boost::posix_time::ptime t)
   const double zLocal = input.foundation.surfaceRoughness;  // [m]
   const double vMult = pow(deltaWS/zWS,alphaWS)*pow(zLocal/deltaLocal,alphaLocal);
 
-  bcs.localWindSpeed = vWS*vMult;
+  boundaryConditions.localWindSpeed = vWS*vMult;
 
-  bcs.solarAzimuth = weatherData.azimuth.getValue(t);
-  bcs.solarAltitude = weatherData.altitude.getValue(t);
-  bcs.directNormalFlux = weatherData.directNormalSolar.getValue(t);
-  bcs.globalHorizontalFlux = weatherData.globalHorizontalSolar.getValue(t);
-  bcs.diffuseHorizontalFlux = weatherData.diffuseHorizontalSolar.getValue(t);
-  bcs.skyEmissivity = weatherData.skyEmissivity.getValue(t);
+  boundaryConditions.solarAzimuth = weatherData.azimuth.getValue(t);
+  boundaryConditions.solarAltitude = weatherData.altitude.getValue(t);
+  boundaryConditions.directNormalFlux = weatherData.directNormalSolar.getValue(t);
+  boundaryConditions.globalHorizontalFlux = weatherData.globalHorizontalSolar.getValue(t);
+  boundaryConditions.diffuseHorizontalFlux = weatherData.diffuseHorizontalSolar.getValue(t);
+  boundaryConditions.skyEmissivity = weatherData.skyEmissivity.getValue(t);
 
 }
 
-std::string Simulator::printOutputHeaders()
+void Simulator::initializeOutputReport()
 {
-  std::string outputHeader = "";
+  reportIndices.clear();
+  reportAreas.clear();
+
+  for (auto out : input.output.outputReport)
+  {
+    std::vector<std::size_t> indices;
+    double totalArea = 0.0;
+    for (auto surface : out.surfaces)
+    {
+      if (ground.foundation.hasSurface[surface]) {
+        indices.push_back(ground.groundOutput.getOutputIndex(surface, out.outType));
+        totalArea += ground.foundation.surfaceAreas[surface];
+      }
+    }
+    reportIndices.push_back(indices);
+    reportAreas.push_back(totalArea);
+  }
+}
 
+void Simulator::openOutputFile(OutputWriter &writer, std::string fileName)
+{
+  std::vector<std::string> headers;
   for (size_t o = 0; o < input.output.outputReport.size(); o++)
   {
-    outputHeader += ", " + input.output.outputReport[o].headerText;
+    std::string header = input.output.outputReport[o].headerText;
+    if (input.output.outputReport.interval != OutputReport::I_TIMESTEP)
+    {
+      switch (input.output.outputReport[o].aggregation)
+      {
+      case OutputVariable::A_SUM:
+        header += " (Sum)";
+        break;
+      case OutputVariable::A_MINIMUM:
+        header += " (Minimum)";
+        break;
+      case OutputVariable::A_MAXIMUM:
+        header += " (Maximum)";
+        break;
+      default:
+        break;
+      }
+    }
+    headers.push_back(header);
   }
 
-  return outputHeader;
+  OutputWriter::Format format =
+      input.output.outputReport.format == OutputReport::F_BINARY ?
+      OutputWriter::F_BINARY : OutputWriter::F_CSV;
+
+  writer.open(fileName, format, headers);
 }
 
-std::string Simulator::printOutputLine()
+void Simulator::writeOutput(OutputWriter &writer, OutputAggregator &aggregator,
+                            boost::posix_time::ptime t, double duration, const double* values)
 {
-  std::string outputLine = "";
+  if (input.output.outputReport.interval == OutputReport::I_TIMESTEP)
+    writer.write(t, values);
+  else if (aggregator.add(t, duration, values))
+    writer.write(aggregator.getTime(), aggregator.getValues());
+}
 
-  for (auto out : input.output.outputReport)
+void Simulator::finishOutput(OutputWriter &writer, OutputAggregator &aggregator)
+{
+  if (input.output.outputReport.interval != OutputReport::I_TIMESTEP && aggregator.finish())
+    writer.write(aggregator.getTime(), aggregator.getValues());
+}
+
+void Simulator::getOutputValues(Ground &g, double* values, long member)
+{
+  for (size_t o = 0; o < input.output.outputReport.size(); o++)
   {
 
     double totalValue = 0.0;
-    double totalArea= 0.0;
-    for (auto surface : out.surfaces)
+    for (auto index : reportIndices[o])
     {
-      if (ground.foundation.hasSurface[surface]) {
-        totalValue += ground.getSurfaceAverageValue({surface,out.outType});
-        totalArea += ground.foundation.surfaceAreas[surface];
-      }
+      if (member < 0)
+        totalValue += g.getSurfaceAverageValue(index);
+      else
+        totalValue += g.getEnsembleSurfaceAverageValue(member,index);
     }
 
-    if (out.outType == GroundOutput::OT_RATE) {
-      outputLine += ", " + boost::lexical_cast<std::string>(totalValue);
+    if (input.output.outputReport[o].outType == GroundOutput::OT_RATE) {
+      values[o] = totalValue;
     }
     else {
-      outputLine += ", " + boost::lexical_cast<std::string>(totalValue/totalArea);
+      values[o] = totalValue/reportAreas[o];
     }
   }
-
-  return outputLine;
-
 }
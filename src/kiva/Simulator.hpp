@@ -5,6 +5,12 @@
 #define Simulator_HPP
 
 #include <iostream>
+#include <deque>
+#include <memory>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <mgl2/mgl.h>
 
@@ -12,9 +18,15 @@
 #include <boost/date_time/gregorian/gregorian.hpp>
 
 #include "BoundaryConditions.hpp"
+#include "Checkpoint.hpp"
+#include "FieldWriter.hpp"
 #include "Ground.hpp"
 #include "GroundOutput.hpp"
 #include "GroundPlot.hpp"
+#include "InitializationCache.hpp"
+#include "OutputAggregator.hpp"
+#include "OutputPipeline.hpp"
+#include "OutputWriter.hpp"
 #include "WeatherData.hpp"
 
 using namespace Kiva;
@@ -24,7 +36,10 @@ public:
   // Constructor
   Simulator(WeatherData &weatherData,
       Input &input,
-      std::string outputFileName);
+      std::string outputFileName,
+      std::string restartFileName = "",
+      InitializationCache* initializationCache = NULL,
+      PhaseTimer* timer = NULL);
 
   virtual ~Simulator();
   void simulate();
@@ -36,34 +51,111 @@ public:
 
   double percentComplete;
 
+  double warmupConvergenceMetric;  // [K] last change between convergence checks
+  double warmupDaysSimulated;
+
+  // The complete state of the simulation is written to the checkpoint file
+  // at the end of the simulation and, if the frequency is not zero, whenever
+  // that much simulated time has passed since the start of the simulation
+  std::string checkpointFileName;
+  boost::posix_time::time_duration checkpointFrequency;
+
 private:
 
   Ground ground;
   BoundaryConditions bcs;
 
+  // Copy of the foundation before its domain is built (used to construct
+  // additional ground instances)
+  Foundation unbuiltFoundation;
+
   std::vector<GroundPlot> plots;
-  std::ofstream outputFile;
+
+  // Output file writing (declared before the output files so that it
+  // outlives them) and snapshot rendering, where independent frames are
+  // rendered concurrently
+  OutputPipeline outputPipeline;
+  OutputPipeline renderPipeline;
+
+  OutputWriter outputFile;
+  OutputAggregator outputAggregator;
+
+  // Raw temperature fields (written by the output pipeline)
+  std::deque<FieldWriter> fields;
+  void initializeFields();
+  void writeFields(boost::posix_time::ptime t);
+
+  bool isRootProcess;  // Only the root process writes output
+
+  PhaseTimer* timer;  // Time spent in each phase of the run (if not null)
+
+  // Ensemble of indoor air temperature schedules
+  std::deque<OutputWriter> ensembleOutputFiles;
+  std::vector<OutputAggregator> ensembleAggregators;
+  std::vector<BoundaryConditions> ensembleBCs;
+  void initializeEnsemble(std::string outputFileName);
   void initializePlots();
   void initializeConditions();
 
 
   void printStatus(boost::posix_time::ptime t);
 
-  std::string printOutputHeaders();
-  std::string printOutputLine();
+  // Output report columns resolved to surface average output indices (see
+  // GroundOutput::getOutputIndex) and the total area of their surfaces
+  std::vector<std::vector<std::size_t>> reportIndices;
+  std::vector<double> reportAreas;
+  void initializeOutputReport();
+
+  std::vector<double> outputValues;
+  void openOutputFile(OutputWriter &writer, std::string fileName);
+  void getOutputValues(Ground &g, double* values, long member = -1);
+  void writeOutput(OutputWriter &writer, OutputAggregator &aggregator,
+                   boost::posix_time::ptime t, double duration, const double* values);
+  void finishOutput(OutputWriter &writer, OutputAggregator &aggregator);
 
 
   void plot(boost::posix_time::ptime t);
 
+  void simulateParareal();
+
   boost::posix_time::ptime prevStatusUpdate;
   boost::posix_time::ptime prevOutputTime;
   bool initPeriod;
 
+  // Time of the first timestep (later than the start of the simulation when
+  // resuming from a checkpoint)
+  boost::posix_time::ptime resumeTime;
+  bool restarted;
+  void writeCheckpoint(boost::posix_time::ptime t);
+  void readCheckpoint(std::string fileName);
+  void saveSolution(Checkpoint &checkpoint, long member = -1);
+  void restoreSolution(Checkpoint &checkpoint, long member = -1);
+
+  // Initialized temperatures reused from earlier runs with the same key
+  std::string getInitializationKey(const InitializationCache &cache);
+  bool readInitializationCache(InitializationCache &cache);
+  void writeInitializationCache(InitializationCache &cache);
+
   double getInitialTemperature(boost::posix_time::ptime t, double z);
 
   double getDeepGroundTemperature();
 
+  std::vector<double> getWarmupConvergenceValues();
+
   void updateBoundaryConditions(boost::posix_time::ptime t);
+  void updateBoundaryConditions(boost::posix_time::ptime t, BoundaryConditions &boundaryConditions);
+  void calculateBoundaryConditions(boost::posix_time::ptime t, BoundaryConditions &boundaryConditions);
+
+  // Boundary conditions (and ensemble indoor temperatures, member-major
+  // within each step) for every timestep of the warmup and simulation
+  // periods, calculated once before initialization. Other times (e.g.,
+  // implicit acceleration or coarse Parareal steps) are calculated directly.
+  boost::posix_time::ptime bcTableStart;
+  boost::posix_time::time_duration bcTableStep;
+  std::vector<BoundaryConditions> bcTable;
+  std::vector<double> ensembleIndoorTempTable;
+  void precomputeBoundaryConditions();
+  long getBoundaryConditionIndex(boost::posix_time::ptime t);
 
 };
 
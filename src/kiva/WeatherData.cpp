@@ -6,39 +6,241 @@
 
 #include "WeatherData.hpp"
 
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
 static const double PI = 4.0*atan(1.0);
 
-std::istream& safeGetline(std::istream& is, std::string& t)
+bool DelimitedText::open(std::string fileName)
+{
+  std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+    return false;
+
+  file.seekg(0, std::ios::end);
+  std::streamoff length = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  buffer.resize(std::size_t(length > 0 ? length : 0));
+  if (!buffer.empty())
+    file.read(&buffer[0], length);
+
+  position = buffer.empty() ? NULL : &buffer[0];
+  end = position + buffer.size();
+  fields.clear();
+  return bool(file);
+}
+
+bool DelimitedText::nextRow()
+{
+  fields.clear();
+  if (position == end)
+    return false;
+
+  // Lines end with "\n", "\r\n", or "\r". Fields are separated by commas
+  // and may be enclosed in double quotes.
+  const char* fieldBegin = position;
+  bool quoted = false;
+  for (;;)
+  {
+    if (position == end || (!quoted && (*position == ',' || *position == '\n' || *position == '\r')))
+    {
+      const char* fieldEnd = position;
+      if (fieldEnd - fieldBegin >= 2 && *fieldBegin == '"' && *(fieldEnd - 1) == '"')
+      {
+        fieldBegin++;
+        fieldEnd--;
+      }
+      fields.push_back(std::make_pair(fieldBegin, fieldEnd));
+
+      if (position == end)
+        break;
+
+      char c = *position++;
+      if (c == ',')
+      {
+        fieldBegin = position;
+        continue;
+      }
+      if (c == '\r' && position != end && *position == '\n')
+        position++;
+      break;
+    }
+    if (*position == '"')
+      quoted = !quoted;
+    position++;
+  }
+  return true;
+}
+
+unsigned long long DelimitedText::getHash() const
+{
+  return getHash(buffer.data(), buffer.size());
+}
+
+unsigned long long DelimitedText::getHash(const char* data, std::size_t size)
 {
-    t.clear();
-
-    // The characters in the stream are read one-by-one using a std::streambuf.
-    // That is faster than reading them one-by-one using the std::istream.
-    // Code that uses streambuf this way must be guarded by a sentry object.
-    // The sentry object performs various tasks,
-    // such as thread synchronization and updating the stream state.
-
-    std::istream::sentry se(is, true);
-    std::streambuf* sb = is.rdbuf();
-
-    for(;;) {
-        int c = sb->sbumpc();
-        switch (c) {
-        case '\n':
-            return is;
-        case '\r':
-            if(sb->sgetc() == '\n')
-                sb->sbumpc();
-            return is;
-        case EOF:
-            // Also handle the case when the last line has no line ending
-            if(t.empty())
-                is.setstate(std::ios::eofbit);
-            return is;
-        default:
-            t += (char)c;
-        }
+  // FNV-1a over 8-byte words (and any remaining bytes), seeded with the length
+  const unsigned long long prime = 1099511628211ULL;
+  unsigned long long hash = 14695981039346656037ULL ^ size;
+
+  std::size_t nWords = size/8;
+  for (std::size_t w = 0; w < nWords; w++)
+  {
+    unsigned long long word;
+    memcpy(&word, &data[8*w], 8);
+    hash = (hash ^ word)*prime;
+  }
+  for (std::size_t b = 8*nWords; b < size; b++)
+    hash = (hash ^ (unsigned char)data[b])*prime;
+
+  return hash;
+}
+
+std::size_t DelimitedText::size() const
+{
+  return fields.size();
+}
+
+std::pair<const char*, const char*> DelimitedText::getField(std::size_t column) const
+{
+  if (column >= fields.size())
+  {
+    std::cerr << "Error: Missing column " << column + 1 << " in data file." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return fields[column];
+}
+
+std::string DelimitedText::getString(std::size_t column) const
+{
+  std::pair<const char*, const char*> field = getField(column);
+  return std::string(field.first, field.second);
+}
+
+double DelimitedText::getDouble(std::size_t column) const
+{
+  std::pair<const char*, const char*> field = getField(column);
+  const char* p = field.first;
+  const char* e = field.second;
+
+  // Fast path: up to 19 significant digits scaled by an exact power of ten.
+  // Both operands are exact, so the single rounding of the product (or
+  // quotient) gives the correctly rounded value.
+  static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+      1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+      1e20, 1e21, 1e22};
+
+  bool negative = false;
+  if (p != e && (*p == '-' || *p == '+'))
+  {
+    negative = *p == '-';
+    p++;
+  }
+
+  unsigned long long mantissa = 0;
+  int significantDigits = 0;
+  int exponent = 0;
+  bool hasDigits = false;
+
+  for (; p != e && *p >= '0' && *p <= '9'; p++)
+  {
+    hasDigits = true;
+    if (significantDigits < 19)
+    {
+      mantissa = mantissa*10 + (*p - '0');
+      if (mantissa > 0)
+        significantDigits++;
+    }
+    else
+      exponent++;
+  }
+  if (p != e && *p == '.')
+  {
+    for (p++; p != e && *p >= '0' && *p <= '9'; p++)
+    {
+      hasDigits = true;
+      if (significantDigits < 19)
+      {
+        mantissa = mantissa*10 + (*p - '0');
+        if (mantissa > 0)
+          significantDigits++;
+        exponent--;
+      }
+    }
+  }
+  if (hasDigits && p != e && (*p == 'e' || *p == 'E'))
+  {
+    const char* q = p + 1;
+    bool negativeExponent = false;
+    if (q != e && (*q == '-' || *q == '+'))
+    {
+      negativeExponent = *q == '-';
+      q++;
     }
+    int value = 0;
+    bool hasExponentDigits = false;
+    for (; q != e && *q >= '0' && *q <= '9' && value < 10000; q++)
+    {
+      value = value*10 + (*q - '0');
+      hasExponentDigits = true;
+    }
+    if (hasExponentDigits)
+    {
+      exponent += negativeExponent ? -value : value;
+      p = q;
+    }
+  }
+
+  if (hasDigits && p == e && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+  {
+    double value = double(mantissa);
+    if (exponent < 0)
+      value /= powersOfTen[-exponent];
+    else
+      value *= powersOfTen[exponent];
+    return negative ? -value : value;
+  }
+
+  // Slow path (long mantissas, large exponents, or special values)
+  std::string text(field.first, field.second);
+  char* parsedEnd;
+  double value = strtod(text.c_str(), &parsedEnd);
+  if (text.empty() || *parsedEnd != '\0')
+  {
+    std::cerr << "Error: Unable to read \"" << text << "\" as a number." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+long DelimitedText::getLong(std::size_t column) const
+{
+  std::pair<const char*, const char*> field = getField(column);
+  const char* p = field.first;
+
+  bool negative = false;
+  if (p != field.second && (*p == '-' || *p == '+'))
+  {
+    negative = *p == '-';
+    p++;
+  }
+
+  long value = 0;
+  bool hasDigits = false;
+  for (; p != field.second && *p >= '0' && *p <= '9'; p++)
+  {
+    value = value*10 + (*p - '0');
+    hasDigits = true;
+  }
+
+  if (!hasDigits || p != field.second)
+  {
+    std::cerr << "Error: Unable to read \"" << getString(column) << "\" as an integer." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return negative ? -value : value;
 }
 
 HourlyData::HourlyData()
@@ -114,88 +316,89 @@ double HourlyData::getMax()
   return *max_element((*this).begin(),(*this).end());
 }
 
-WeatherData::WeatherData(std::string weatherFile)
+WeatherData::WeatherData(std::string weatherFile, std::string cacheDirectory)
 {
   globalHorizontalSolar.dataType = HourlyData::DT_SOLAR;
   directNormalSolar.dataType = HourlyData::DT_SOLAR;
   diffuseHorizontalSolar.dataType = HourlyData::DT_SOLAR;
-  importEPW(weatherFile);
-}
-
-void WeatherData::importEPW(std::string epwFile)
-{
 
-  std::ifstream inf;
-  inf.open(epwFile.c_str());
+  DelimitedText text;
 
-  if (!inf)
+  if (!text.open(weatherFile))
   {
       // Print an error and exit
       std::cerr << "Unable to read EPW file" << std::endl;
       exit(EXIT_FAILURE);
   }
 
-  // While there's still stuff left to read
-  std::string line;
-  std::vector <std::string> columns;
+  hash = text.getHash();
+
+  if (cacheDirectory.empty())
+  {
+    importEPW(text);
+    return;
+  }
+
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << hash << ".kwc";
+  std::string cacheFile = (boost::filesystem::path(cacheDirectory) / name.str()).string();
 
-  typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
+  if (!readCache(cacheFile, hash))
+  {
+    importEPW(text);
+    writeCache(cacheFile, hash);
+  }
+}
 
+void WeatherData::importEPW(DelimitedText &text)
+{
   int row = 0;
   long hour = 0;
-
   hourOfMinimumTemperature = hour;
   double Tmin = 9999;
 
   std::vector<int> months;
   std::vector<int> days;
-
   int dayOfYear = 1;
   int previousDayOfMonth = 1;
 
-  while (!safeGetline(inf,line).eof())
+  const std::size_t hoursPerYear = 8760;
+  months.reserve(hoursPerYear);
+  days.reserve(hoursPerYear);
+  HourlyData* series[] = {&dryBulbTemp, &dewPointTemp, &relativeHumidity,
+      &atmosphericPressure, &directNormalSolar, &diffuseHorizontalSolar,
+      &windDirection, &windSpeed, &totalSkyCover, &opaqueSkyCover,
+      &skyEmissivity, &skyTemp, &altitude, &globalHorizontalSolar, &azimuth};
+  for (std::size_t d = 0; d < sizeof(series)/sizeof(series[0]); d++)
+    series[d]->reserve(hoursPerYear);
+
+  while (text.nextRow())
   {
     row += 1;
-    Tokenizer tok(line, boost::escaped_list_separator<char>("\\",",","\""));
-
-    for (boost::tokenizer< boost::escaped_list_separator<char> >::iterator
-        i(tok.begin()); i!=tok.end(); ++i)
-    {
-      columns.push_back(*i);
-    }
 
     if (row == 1)
     {
       // Site information
-      city = columns[1];
-      state = columns[2];
-      country = columns[3];
-      latitude = double(boost::lexical_cast<double>(columns[6]));
-      longitude = double(boost::lexical_cast<double>(columns[7]));
-      timezone = double(boost::lexical_cast<double>(columns[8]));
-      //elevation = double(boost::lexical_cast<double>(columns[9]));
+      city = text.getString(1);
+      state = text.getString(2);
+      country = text.getString(3);
+      latitude = text.getDouble(6);
+      longitude = text.getDouble(7);
+      timezone = text.getDouble(8);
+      //elevation = text.getDouble(9);
     }
 
-    boost::gregorian::date newYear(2013,boost::gregorian::Jan,1);
-    boost::posix_time::ptime newYearDate(newYear);
-
-
     if (row > 8)
     {
-      boost::posix_time::ptime dateTime = newYearDate + boost::posix_time::hours(hour);
-      double hourOfDay = dateTime.time_of_day().total_seconds()/3600.0;
-
-      double Tdb = double(boost::lexical_cast<double>(columns[6])) + 273.15;
-
-      months.push_back(int(boost::lexical_cast<int>(columns[1])));
+      double Tdb = text.getDouble(6) + 273.15;
 
-      int dayOfMonth = int(boost::lexical_cast<int>(columns[2]));
+      months.push_back(int(text.getLong(1)));
+      int dayOfMonth = int(text.getLong(2));
 
       if (dayOfMonth != previousDayOfMonth)
         dayOfYear += 1;
 
       days.push_back(dayOfYear);
-
       previousDayOfMonth = dayOfMonth;
 
       if (Tdb < Tmin)
@@ -205,73 +408,70 @@ void WeatherData::importEPW(std::string epwFile)
       }
 
       dryBulbTemp.push_back(Tdb);  // [K]
-
-      double Tdp = double(boost::lexical_cast<double>(columns[7])) +
-                273.15;
-
+      double Tdp = text.getDouble(7) + 273.15;
       dewPointTemp.push_back(Tdp);  // [K]
-
-      relativeHumidity.push_back(
-          double(boost::lexical_cast<double>(columns[8]))/100.0);  // [frac]
-
-      atmosphericPressure.push_back(
-          double(boost::lexical_cast<double>(columns[9])));  // [Pa]
+      relativeHumidity.push_back(text.getDouble(8)/100.0);  // [frac]
+      atmosphericPressure.push_back(text.getDouble(9));  // [Pa]
 
       // Note: global horizontal solar can be calculated using solar position,
       // direct normal solar and diffuse solar.
-      // double qGH = double(boost::lexical_cast<double>(columns[13]));
-
-      double qDN = double(boost::lexical_cast<double>(columns[14]));
-
-      directNormalSolar.push_back(qDN);  // [W/m2]
-
-      double qDH = double(boost::lexical_cast<double>(columns[15]));
-
-      diffuseHorizontalSolar.push_back(qDH);  // [W/m2]
-
-      windDirection.push_back(double(boost::lexical_cast<double>(columns[20]))*PI/180.0);  // [rad]
-
-      windSpeed.push_back(
-          double(boost::lexical_cast<double>(columns[21])));  // [m/s]
-
-      double fc = double(boost::lexical_cast<double>(columns[22]));
-
+      // double qGH = text.getDouble(13);
+      directNormalSolar.push_back(text.getDouble(14));  // [W/m2]
+      diffuseHorizontalSolar.push_back(text.getDouble(15));  // [W/m2]
+      windDirection.push_back(text.getDouble(20)*PI/180.0);  // [rad]
+      windSpeed.push_back(text.getDouble(21));  // [m/s]
+      double fc = text.getDouble(22);
       totalSkyCover.push_back(fc);  // [tenths]
-
-      opaqueSkyCover.push_back(
-          double(boost::lexical_cast<double>(columns[23])));  // [tenths]
+      opaqueSkyCover.push_back(text.getDouble(23));  // [tenths]
 
       double eSky = 0.787 + 0.764*log(Tdp/Tdb)*
           (1 + 0.0224*fc - 0.0035*pow(fc,2) + 0.00028*pow(fc,3));
-
       skyEmissivity.push_back(eSky);  // [frac]
-
       double Tsky = pow(eSky,0.25)*Tdb;
-
       skyTemp.push_back(Tsky);
 
-      // Solar calculations (from Duffie & Beckman)
-      double day = dateTime.date().day_of_year();
-      double B = (day - 1)*360/365*PI/180;
-      double EOT = 229.2*(0.000075 + 0.001868*cos(B) - 0.032077*sin(B)
-               - 0.014615*cos(2*B) - 0.04089*sin(2*B));
-      double declination = 0.006918 - 0.399912*cos(B) + 0.070257*sin(B)
-                           - 0.006758*cos(2*B) + 0.000907*sin(2*B)
-                           - 0.002697*cos(3*B) + 0.00148*sin(3*B);
-      double solarHour = (hourOfDay - 0.5) + (4*(timezone*15.0 - longitude) + EOT)/60.0;
-      double hourAngle = (solarHour - 12.00)*15.0;
+      hour++;
+    }
+  }
 
-      double sinLat = sin(latitude*PI/180);
-      double cosLat = cos(latitude*PI/180);
-      double sinDec = sin(declination*PI/180);
-      double cosDec = cos(declination*PI/180);
-      double cosHA = cos(hourAngle*PI/180);
+  // Solar calculations (from Duffie & Beckman) in a separate pass over the
+  // hours of the (non-leap) year, with the day-dependent terms evaluated once
+  // per day
+  std::size_t nHours = directNormalSolar.size();
+  altitude.resize(nHours);
+  globalHorizontalSolar.resize(nHours);
+  azimuth.resize(nHours);
+
+  double sinLat = sin(latitude*PI/180);
+  double cosLat = cos(latitude*PI/180);
+  double timeCorrection = 4*(timezone*15.0 - longitude);
+
+  for (std::size_t dayStart = 0; dayStart < nHours; dayStart += 24)
+  {
+    double day = double(dayStart/24 + 1);
+    double B = (day - 1)*360/365*PI/180;
+    double EOT = 229.2*(0.000075 + 0.001868*cos(B) - 0.032077*sin(B)
+             - 0.014615*cos(2*B) - 0.04089*sin(2*B));
 
+    double declination = 0.006918 - 0.399912*cos(B) + 0.070257*sin(B)
+                         - 0.006758*cos(2*B) + 0.000907*sin(2*B)
+                         - 0.002697*cos(3*B) + 0.00148*sin(3*B);
+
+    double sinDec = sin(declination*PI/180);
+    double cosDec = cos(declination*PI/180);
+
+    std::size_t dayEnd = std::min(dayStart + 24, nHours);
+    for (std::size_t h = dayStart; h < dayEnd; h++)
+    {
+      double hourOfDay = double(h - dayStart);
+      double solarHour = (hourOfDay - 0.5) + (timeCorrection + EOT)/60.0;
+      double hourAngle = (solarHour - 12.00)*15.0;
+      double cosHA = cos(hourAngle*PI/180);
       double alt = asin(sinLat*sinDec + cosLat*cosDec*cosHA);
-      altitude.push_back(alt);
+      altitude[h] = alt;
 
-      double qGH = cos(PI/2 - alt)*qDN + qDH;
-      globalHorizontalSolar.push_back(qGH);  // [W/m2]
+      double qGH = cos(PI/2 - alt)*directNormalSolar[h] + diffuseHorizontalSolar[h];
+      globalHorizontalSolar[h] = qGH;  // [W/m2]
 
       // clockwise from north
       double azi = PI + acos((sin(alt)*sinLat - sinDec)/(cos(alt)*cosLat));
@@ -280,17 +480,10 @@ void WeatherData::importEPW(std::string epwFile)
       {
         azi = 2*PI - azi;
       }
-
-      azimuth.push_back(azi);
-
-      hour++;
+      azimuth[h] = azi;
     }
-    columns.clear();
-
   }
 
-  inf.close();
-
   // Calculate average daily and monthly temperatures
   dailyAverageTemperatures.reserve(365);
   monthlyAverageTemperatures.reserve(12);
@@ -339,4 +532,156 @@ void WeatherData::importEPW(std::string epwFile)
 
 }
 
+// Weather cache layout (native byte order): header (magic, version, byte
+// order mark, EPW hash), site strings, scalar values, then each series as a
+// count followed by its values
+static const char cacheMagic[8] = {'K','I','V','A','W','T','H','R'};
+static const unsigned int cacheVersion = 1;
+static const unsigned int cacheByteOrder = 0x01020304;
+
+static void writeCacheString(std::ofstream &file, const std::string &value)
+{
+  unsigned long long length = value.size();
+  file.write((const char*)&length, sizeof(length));
+  file.write(value.data(), length);
+}
+
+static bool readCacheString(std::ifstream &file, std::string &value)
+{
+  unsigned long long length;
+  if (!file.read((char*)&length, sizeof(length)) || length > 4096)
+    return false;
+  value.resize(length);
+  return length == 0 || file.read(&value[0], length);
+}
+
+static void writeCacheSeries(std::ofstream &file, const std::vector<double> &values)
+{
+  unsigned long long count = values.size();
+  file.write((const char*)&count, sizeof(count));
+  if (count > 0)
+    file.write((const char*)&values[0], count*sizeof(double));
+}
+
+static bool readCacheSeries(std::ifstream &file, std::vector<double> &values,
+    unsigned long long expectedCount)
+{
+  unsigned long long count;
+  if (!file.read((char*)&count, sizeof(count)) || count != expectedCount)
+    return false;
+  values.resize(count);
+  return bool(file.read((char*)&values[0], count*sizeof(double)));
+}
+
+bool WeatherData::readCache(std::string cacheFile, unsigned long long hash)
+{
+  std::ifstream file(cacheFile.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+    return false;
+
+  char magic[8];
+  unsigned int version, byteOrder;
+  unsigned long long fileHash;
+  file.read(magic, sizeof(magic));
+  file.read((char*)&version, sizeof(version));
+  file.read((char*)&byteOrder, sizeof(byteOrder));
+  file.read((char*)&fileHash, sizeof(fileHash));
+  if (!file || memcmp(magic, cacheMagic, sizeof(magic)) != 0 ||
+      version != cacheVersion || byteOrder != cacheByteOrder || fileHash != hash)
+    return false;
+
+  // Everything is read into temporaries first, so a damaged cache leaves the
+  // members untouched for importEPW
+  std::string cacheCity, cacheState, cacheCountry;
+  if (!readCacheString(file, cacheCity) || !readCacheString(file, cacheState) ||
+      !readCacheString(file, cacheCountry))
+    return false;
+
+  double scalars[6];
+  if (!file.read((char*)scalars, sizeof(scalars)))
+    return false;
+
+  std::vector<double>* series[] = {&dailyAverageTemperatures,
+      &monthlyAverageTemperatures, &dryBulbTemp, &dewPointTemp,
+      &atmosphericPressure, &relativeHumidity, &globalHorizontalSolar,
+      &directNormalSolar, &diffuseHorizontalSolar, &windDirection, &windSpeed,
+      &totalSkyCover, &opaqueSkyCover, &skyEmissivity, &skyTemp, &altitude,
+      &azimuth};
+  const std::size_t nSeries = sizeof(series)/sizeof(series[0]);
+  std::vector<double> values[nSeries];
+  for (std::size_t d = 0; d < nSeries; d++)
+  {
+    // daily and monthly averages, then hourly series
+    unsigned long long expectedCount = d == 0 ? 365 : d == 1 ? 12 : 8760;
+    if (!readCacheSeries(file, values[d], expectedCount))
+      return false;
+  }
+
+  city.swap(cacheCity);
+  state.swap(cacheState);
+  country.swap(cacheCountry);
+  timezone = scalars[0];
+  latitude = scalars[1];
+  longitude = scalars[2];
+  hourOfMinimumTemperature = scalars[3];
+  minimumAverageMontlyTemperature = scalars[4];
+  maximumAverageMontlyTemperature = scalars[5];
+  for (std::size_t d = 0; d < nSeries; d++)
+    series[d]->swap(values[d]);
+
+  return true;
+}
+
+void WeatherData::writeCache(std::string cacheFile, unsigned long long hash)
+{
+  // Written to a uniquely named temporary file and then renamed, so
+  // concurrent runs never read a partial cache. Failures only mean that the
+  // cache is not available to later runs.
+  boost::system::error_code ec;
+  boost::filesystem::path cachePath(cacheFile);
+  boost::filesystem::create_directories(cachePath.parent_path(), ec);
+  boost::filesystem::path tempPath = cachePath.parent_path() /
+      boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%.tmp", ec);
+  if (ec)
+    return;
+
+  std::ofstream file(tempPath.string().c_str(), std::ios::out | std::ios::binary);
+  if (!file)
+    return;
+
+  file.write(cacheMagic, sizeof(cacheMagic));
+  file.write((const char*)&cacheVersion, sizeof(cacheVersion));
+  file.write((const char*)&cacheByteOrder, sizeof(cacheByteOrder));
+  file.write((const char*)&hash, sizeof(hash));
+
+  writeCacheString(file, city);
+  writeCacheString(file, state);
+  writeCacheString(file, country);
+
+  double scalars[6] = {timezone, latitude, longitude,
+      double(hourOfMinimumTemperature), minimumAverageMontlyTemperature,
+      maximumAverageMontlyTemperature};
+  file.write((const char*)scalars, sizeof(scalars));
+
+  const std::vector<double>* series[] = {&dailyAverageTemperatures,
+      &monthlyAverageTemperatures, &dryBulbTemp, &dewPointTemp,
+      &atmosphericPressure, &relativeHumidity, &globalHorizontalSolar,
+      &directNormalSolar, &diffuseHorizontalSolar, &windDirection, &windSpeed,
+      &totalSkyCover, &opaqueSkyCover, &skyEmissivity, &skyTemp, &altitude,
+      &azimuth};
+  for (std::size_t d = 0; d < sizeof(series)/sizeof(series[0]); d++)
+    writeCacheSeries(file, *series[d]);
+
+  file.close();
+  if (!file)
+  {
+    boost::filesystem::remove(tempPath, ec);
+    return;
+  }
+
+  boost::filesystem::rename(tempPath, cachePath, ec);
+  if (ec)
+    boost::filesystem::remove(tempPath, ec);
+}
+
 #endif
@@ -9,13 +9,42 @@
 #include <numeric>
 #include <iostream>
 
-#include <boost/tokenizer.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
+#include <boost/filesystem/operations.hpp>
 
-std::istream& safeGetline(std::istream& is, std::string& t);
+// Comma-delimited text (EPW and time-series data files) read into memory in
+// one pass and split into fields in place
+class DelimitedText
+{
+public:
+
+  bool open(std::string fileName);
+
+  // 64-bit hash of the file contents
+  unsigned long long getHash() const;
+  static unsigned long long getHash(const char* data, std::size_t size);
+
+  // Split the next line into fields (false at the end of the file)
+  bool nextRow();
+
+  std::size_t size() const;
+  std::string getString(std::size_t column) const;
+  double getDouble(std::size_t column) const;
+  long getLong(std::size_t column) const;
+
+private:
+
+  std::vector<char> buffer;
+  const char* position;
+  const char* end;
+  std::vector<std::pair<const char*, const char*>> fields;
+
+  std::pair<const char*, const char*> getField(std::size_t column) const;
+
+};
 
 
 class HourlyData: public std::vector<double>
@@ -86,10 +115,18 @@ public:
   HourlyData azimuth;
 
 public:
-  WeatherData(std::string weatherFile);
+  // If a cache directory is given, the processed weather data is stored
+  // there in binary form (keyed by a hash of the EPW contents) and reused by
+  // later runs with the same file
+  WeatherData(std::string weatherFile, std::string cacheDirectory = "");
+
+  unsigned long long hash;  // of the EPW file contents
 
 private:
-  void importEPW(std::string epwFile);
+  void importEPW(DelimitedText &text);
+
+  bool readCache(std::string cacheFile, unsigned long long hash);
+  void writeCache(std::string cacheFile, unsigned long long hash);
 
 };
 
@@ -33,7 +33,7 @@ double getDOE2ConvectionCoeff(double tilt,
    * for rougness in meters instead, so we multiply by 100.
   */
 
-  double hn;
+  double hn = 0.0;
 
   if (cos(tilt) == 0.0)
   {
@@ -106,5 +106,84 @@ double getSimpleInteriorIRCoeff(double eSurf, double Tsurf, double Tamb)
   return eSurf*SIGMA*(Tamb*Tamb+Tsurf*Tsurf)*(Tamb + Tsurf);
 }
 
+void getDOE2ConvectionCoeffs(std::size_t n,
+                             const double *tilt,
+                             const double *Tsurf,
+                             double Tamb,
+                             double Vair,
+                             double roughness,
+                             double *hc)
+{
+  // Forced convection terms (squared) only depend on wind speed
+  double hfWindward = pow(pow(3.26*Vair,0.89),2);
+  double hfLeeward = pow(pow(3.55*Vair,0.617),2);
+
+  double prevTilt = 0.0;
+  double cosTilt = 1.0;
+  double hf2 = hfWindward;
+
+  for (std::size_t c = 0; c < n; c++)
+  {
+    if (c == 0 || tilt[c] != prevTilt)
+    {
+      prevTilt = tilt[c];
+      cosTilt = cos(tilt[c]);
+      hf2 = isWindward(tilt[c], 0.0, 0.0) ? hfWindward : hfLeeward;
+    }
+
+    double dT = Tsurf[c] - Tamb;
+    double cbrtDT = cbrt(fabs(dT));
+
+    double hn = 0.0;
+
+    if (cosTilt == 0.0)
+      hn = 1.31*cbrtDT;
+    else if ((cosTilt < 0.0 && dT < 0.0) || (cosTilt > 0.0 && dT > 0.0))
+      hn = 9.482*cbrtDT/(7.238 - fabs(cosTilt));
+    else if ((cosTilt < 0.0 && dT > 0.0) || (cosTilt > 0.0 && dT < 0.0))
+      hn = 1.810*cbrtDT/(1.382 - fabs(cosTilt));
+
+    double hcGlass = sqrt(hn*hn + hf2);
+
+    hc[c] = hn + roughness*100*(hcGlass - hn); // convert meters to milimeters
+  }
+}
+
+void getExteriorIRCoeffs(std::size_t n,
+                         const double *eSurf,
+                         const double *Tsurf,
+                         double Tamb,
+                         double eSky,
+                         const double *tilt,
+                         double *hr)
+{
+  double prevTilt = 0.0;
+  double TambF2 = 0.0;
+  double TambF4 = 0.0;
+
+  for (std::size_t c = 0; c < n; c++)
+  {
+    if (c == 0 || tilt[c] != prevTilt)
+    {
+      prevTilt = tilt[c];
+      double F = getEffectiveExteriorViewFactor(eSky, tilt[c]);
+      TambF2 = Tamb*Tamb*pow(F,0.5);
+      TambF4 = Tamb*pow(F,0.25);
+    }
+
+    hr[c] = eSurf[c]*SIGMA*(TambF2+Tsurf[c]*Tsurf[c])*(TambF4+Tsurf[c]);
+  }
+}
+
+void getSimpleInteriorIRCoeffs(std::size_t n,
+                               const double *eSurf,
+                               const double *Tsurf,
+                               double Tamb,
+                               double *hr)
+{
+  for (std::size_t c = 0; c < n; c++)
+    hr[c] = eSurf[c]*SIGMA*(Tamb*Tamb+Tsurf[c]*Tsurf[c])*(Tamb + Tsurf[c]);
+}
+
 }
 #endif
@@ -5,6 +5,7 @@
 #define ConvectionAlgorithms_HPP
 
 #include <cmath>
+#include <cstddef>
 //#include "PixelCounter.hpp"
 
 namespace Kiva {
@@ -45,6 +46,32 @@ double getSimpleInteriorIRCoeff(double eSurf,
                             double Tsurf,
                             double Tamb);
 
+// Batch versions of the above for n surfaces sharing the same ambient
+// conditions. Terms that only depend on the ambient conditions and tilt are
+// evaluated once per distinct tilt rather than per surface, and cube roots
+// use cbrt instead of pow(x,1/3) (agreement within a few ulp).
+void getDOE2ConvectionCoeffs(std::size_t n,
+                             const double *tilt,
+                             const double *Tsurf,
+                             double Tamb,
+                             double Vair,
+                             double roughness,
+                             double *hc);
+
+void getExteriorIRCoeffs(std::size_t n,
+                         const double *eSurf,
+                         const double *Tsurf,
+                         double Tamb,
+                         double eSky,
+                         const double *tilt,
+                         double *hr);
+
+void getSimpleInteriorIRCoeffs(std::size_t n,
+                               const double *eSurf,
+                               const double *Tsurf,
+                               double Tamb,
+                               double *hr);
+
 }
 
 #endif
@@ -23,6 +23,12 @@ Domain::Domain(Foundation &foundation)
 // Having this separate from the constructor allows the correct resizing of
 // multidimensional arrays on pre-existing initialized instances.
 void Domain::setDomain(Foundation &foundation)
+{
+  setMesh(foundation);
+  setCells(foundation, 0, nX);
+}
+
+void Domain::setMesh(Foundation &foundation)
 {
 
   {
@@ -40,180 +46,114 @@ void Domain::setDomain(Foundation &foundation)
   nY = meshY.centers.size();
   nZ = meshZ.centers.size();
 
-  cell.resize(nX,std::vector<std::vector<Cell> >(nY,std::vector<Cell>(nZ)));
+  setSpacings();
+}
+
+void Domain::setCells(Foundation &foundation, std::size_t iFirst, std::size_t iLast)
+{
+  this->iFirst = iFirst;
+  this->iLast = iLast;
+
+  // Zero-thickness cells at the edges of the stored columns take their
+  // properties from the neighboring columns, so these are built as well
+  // (and released once they are used)
+  std::size_t iFirstBuilt = iFirst;
+  std::size_t iLastBuilt = iLast;
+  if (iFirst < iLast)
+  {
+    if (iFirst > 0)
+      iFirstBuilt = iFirst - 1;
+    if (iLast < nX)
+      iLastBuilt = iLast + 1;
+  }
+
+  cell.clear();
+  cell.resize(nX);
+  for (std::size_t i = iFirstBuilt; i < iLastBuilt; i++)
+    cell[i].resize(nY,std::vector<Cell>(nZ));
+
+  // Block and surface footprints are the same for every cell in a column, so
+  // the polygon tests are done once per column (i,j). Cells in the column
+  // are then classified using only the z-extents of the matching blocks and
+  // surfaces.
+  std::vector<std::vector<std::vector<std::size_t> > > columnBlocks(nX,std::vector<std::vector<std::size_t> >(nY));
+  std::vector<std::vector<std::vector<std::size_t> > > columnSurfaces(nX,std::vector<std::vector<std::size_t> >(nY));
+
+  // Boundary cells of each column (surface, j, k, and area), listed in the
+  // order in which they are added to the surface indices. Cells of columns
+  // that are not stored are classified only to find these.
+  std::vector<std::vector<boost::tuple<std::size_t,std::size_t,std::size_t,double> > > columnIndices(nX);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (long iCol = 0; iCol < long(nX); iCol++)
+  {
+    std::size_t i = iCol;
+    bool built = i >= iFirstBuilt && i < iLastBuilt;
+    Cell unstored;
 
-  for (std::size_t i = 0; i < nX; i++)
-  {
     for (std::size_t j = 0; j < nY; j++)
     {
-      for (std::size_t k = 0; k < nZ; k++)
-      {
-
-        // Set Cell Properties
-        cell[i][j][k].density = foundation.soil.density;
-        cell[i][j][k].specificHeat = foundation.soil.specificHeat;
-        cell[i][j][k].conductivity = foundation.soil.conductivity;
-        cell[i][j][k].heatGain = 0.0;
-
-        // Default to normal cells
-        cell[i][j][k].cellType = Cell::NORMAL;
-
-        // Next set interior zero-width cells
-        if (foundation.numberOfDimensions == 3)
-        {
-          if (isEqual(meshX.deltas[i], 0.0) ||
-            isEqual(meshZ.deltas[k], 0.0) ||
-            isEqual(meshY.deltas[j], 0.0))
-          {
-            cell[i][j][k].cellType = Cell::ZERO_THICKNESS;
-          }
-        }
-        else
-        {
-          if (isEqual(meshX.deltas[i], 0.0) ||
-            isEqual(meshZ.deltas[k], 0.0))
-          {
-            cell[i][j][k].cellType = Cell::ZERO_THICKNESS;
-          }
-        }
+      Point center(meshX.centers[i],meshY.centers[j]);
 
+      if (built)
+      {
         for (std::size_t b = 0; b < foundation.blocks.size(); b++)
         {
-          if (boost::geometry::within(Point(meshX.centers[i],meshY.centers[j]), foundation.blocks[b].polygon) &&
-            isGreaterThan(meshZ.centers[k], foundation.blocks[b].zMin) &&
-            isLessThan(meshZ.centers[k], foundation.blocks[b].zMax))
-          {
-            cell[i][j][k].density = foundation.blocks[b].material.density;
-            cell[i][j][k].specificHeat = foundation.blocks[b].material.specificHeat;
-            cell[i][j][k].conductivity = foundation.blocks[b].material.conductivity;
-
-            //cell[i][j][k].blockNumber = b;
-            cell[i][j][k].block = foundation.blocks[b];
-
-
-            if (foundation.blocks[b].blockType == Block::INTERIOR_AIR)
-            {
-              cell[i][j][k].cellType = Cell::INTERIOR_AIR;
-            }
-            else if (foundation.blocks[b].blockType == Block::EXTERIOR_AIR)
-            {
-              cell[i][j][k].cellType = Cell::EXTERIOR_AIR;
-            }
-          }
+          if (boost::geometry::within(center, foundation.blocks[b].polygon))
+            columnBlocks[i][j].push_back(b);
         }
+      }
 
-        for (std::size_t s = 0; s < foundation.surfaces.size(); s++)
-        {
-          if (boost::geometry::intersects(Point(meshX.centers[i],meshY.centers[j]), foundation.surfaces[s].polygon))
-          {
-            if (isGreaterOrEqual(meshZ.centers[k], foundation.surfaces[s].zMin)
-            &&  isLessOrEqual(meshZ.centers[k], foundation.surfaces[s].zMax))
-            {
-              cell[i][j][k].cellType = Cell::BOUNDARY;
-
-              //cell[i][j][k].surfaceNumber = s;
-
-              cell[i][j][k].surface = foundation.surfaces[s];
-
-              // Point/Line cells not on the boundary should be
-              // zero-thickness cells
-              int numZeroDims = getNumZeroDims(i,j,k);
-
-              if (foundation.numberOfDimensions == 3)
-              {
-                if ((numZeroDims > 1) &&
-                  i != 0 && i != nX - 1 &&
-                  j != 0 && j != nY - 1 &&
-                  k != 0 && k != nZ - 1)
-                  cell[i][j][k].cellType = Cell::ZERO_THICKNESS;
-              }
-              else
-              {
-                if ((numZeroDims > 1) &&
-                  i != 0 && i != nX - 1 &&
-                  k != 0 && k != nZ - 1)
-                  cell[i][j][k].cellType = Cell::ZERO_THICKNESS;
-              }
-
-              if (cell[i][j][k].cellType == Cell::BOUNDARY)
-              {
-                foundation.surfaces[s].indices.push_back(boost::tuple<std::size_t,std::size_t,std::size_t> (i,j,k));
-              }
-
-            }
-          }
-        }
+      for (std::size_t s = 0; s < foundation.surfaces.size(); s++)
+      {
+        if (boost::geometry::intersects(center, foundation.surfaces[s].polygon))
+          columnSurfaces[i][j].push_back(s);
+      }
 
-        // Set cell volume
-        cell[i][j][k].volume = meshX.deltas[i]*meshY.deltas[j]*meshZ.deltas[k];
+      if (!built && columnSurfaces[i][j].empty())
+        continue;
 
-        // for boundary cells, set cell area
-        if (cell[i][j][k].cellType == Cell::BOUNDARY)
+      for (std::size_t k = 0; k < nZ; k++)
+      {
+        Cell &c = built ? cell[i][j][k] : unstored;
+        setCell(foundation, i, j, k, columnBlocks[i][j], columnSurfaces[i][j], c);
+
+        if (c.cellType != Cell::BOUNDARY)
+          continue;
+
+        for (std::size_t cs = 0; cs < columnSurfaces[i][j].size(); cs++)
         {
-          if (foundation.numberOfDimensions == 2 &&
-              foundation.coordinateSystem == Foundation::CS_CYLINDRICAL)
-          {
-            if (cell[i][j][k].surface.orientation == Surface::X_POS ||
-              cell[i][j][k].surface.orientation == Surface::X_NEG)
-            {
-              cell[i][j][k].area = 2.0*PI*meshX.centers[i]*meshZ.deltas[k];
-            }
-            else // if (surface.orientation == Surface::Z_POS ||
-               // surface.orientation == Surface::Z_NEG)
-            {
-              cell[i][j][k].area = PI*(meshX.dividers[i+1]*meshX.dividers[i+1] -
-            		  meshX.dividers[i]*meshX.dividers[i] );
-            }
-          }
-          else if (foundation.numberOfDimensions == 2 &&
-                   foundation.coordinateSystem == Foundation::CS_CARTESIAN)
-          {
-            if (cell[i][j][k].surface.orientation == Surface::X_POS ||
-              cell[i][j][k].surface.orientation == Surface::X_NEG)
-            {
-              cell[i][j][k].area = 2.0*meshZ.deltas[k]*foundation.linearAreaMultiplier;
-            }
-            else // if (surface.orientation == Surface::Z_POS ||
-               // surface.orientation == Surface::Z_NEG)
-            {
-              cell[i][j][k].area = 2.0*meshX.deltas[i]*foundation.linearAreaMultiplier;
-            }
-          }
-          else  // if (foundation.numberOfDimensions == 3)
+          std::size_t s = columnSurfaces[i][j][cs];
+          if (isGreaterOrEqual(meshZ.centers[k], foundation.surfaces[s].zMin)
+          &&  isLessOrEqual(meshZ.centers[k], foundation.surfaces[s].zMax))
           {
-            if (cell[i][j][k].surface.orientation == Surface::X_POS ||
-              cell[i][j][k].surface.orientation == Surface::X_NEG)
-            {
-              cell[i][j][k].area = meshY.deltas[j]*meshZ.deltas[k];
-            }
-            else if (cell[i][j][k].surface.orientation == Surface::Y_POS ||
-                 cell[i][j][k].surface.orientation == Surface::Y_NEG)
-            {
-              cell[i][j][k].area = meshX.deltas[i]*meshZ.deltas[k];
-            }
-            else // if (surface.orientation == Surface::Z_POS ||
-               // surface.orientation == Surface::Z_NEG)
-            {
-              cell[i][j][k].area = meshX.deltas[i]*meshY.deltas[j];
-            }
-
-            if (foundation.useSymmetry)
-            {
-              if (foundation.isXSymm)
-                cell[i][j][k].area = 2*cell[i][j][k].area;
-
-              if (foundation.isYSymm)
-                cell[i][j][k].area = 2*cell[i][j][k].area;
-            }
+            columnIndices[i].push_back(boost::make_tuple(s, j, k, double(c.area)));
           }
         }
       }
     }
   }
 
+  // Surface index lists (and areas) are assembled serially to keep them in
+  // (i,j,k) order
+  for (std::size_t s = 0; s < foundation.surfaces.size(); s++)
+    foundation.surfaces[s].area = 0;
+
+  for (std::size_t i = 0; i < nX; i++)
+  {
+    for (std::size_t n = 0; n < columnIndices[i].size(); n++)
+    {
+      std::size_t s = boost::get<0>(columnIndices[i][n]);
+      std::size_t j = boost::get<1>(columnIndices[i][n]);
+      std::size_t k = boost::get<2>(columnIndices[i][n]);
+      foundation.surfaces[s].indices.push_back(boost::tuple<std::size_t,std::size_t,std::size_t> (i,j,k));
+      foundation.surfaces[s].area += boost::get<3>(columnIndices[i][n]);
+    }
+  }
+
   // Set effective properties of zero-thickness cells
   // based on other cells
-  for (std::size_t i = 0; i < nX; i++)
+  for (std::size_t i = iFirst; i < iLast; i++)
   {
     for (std::size_t j = 0; j < nY; j++)
     {
@@ -242,8 +182,17 @@ void Domain::setDomain(Foundation &foundation)
     }
   }
 
+  if (iFirstBuilt < iFirst)
+    std::vector<std::vector<Cell> >().swap(cell[iFirstBuilt]);
+  if (iLastBuilt > iLast)
+    std::vector<std::vector<Cell> >().swap(cell[iLast]);
+
+  // Face conductances depend on the final (including zero-thickness) cell
+  // conductivities
+  setConductances();
+
   // Calculate matrix coefficients
-  for (std::size_t i = 0; i < nX; i++)
+  for (std::size_t i = iFirst; i < iLast; i++)
   {
     for (std::size_t j = 0; j < nY; j++)
     {
@@ -294,192 +243,255 @@ void Domain::setDomain(Foundation &foundation)
       }
     }
   }
-
-  for (std::size_t s = 0; s < foundation.surfaces.size(); s++)
-  {
-    foundation.surfaces[s].area = 0;
-    for (std::size_t index = 0; index < foundation.surfaces[s].indices.size(); index++)
-    {
-      std::size_t i = boost::get<0>(foundation.surfaces[s].indices[index]);
-      std::size_t j = boost::get<1>(foundation.surfaces[s].indices[index]);
-      std::size_t k = boost::get<2>(foundation.surfaces[s].indices[index]);
-
-      foundation.surfaces[s].area += cell[i][j][k].area;
-    }
-  }
 }
 
-double Domain::getDXP(std::size_t i)
+// Classifies cell (i,j,k) and sets its inherent properties and area, given
+// the blocks and surfaces whose footprints contain its column
+void Domain::setCell(Foundation &foundation, std::size_t i, std::size_t j, std::size_t k,
+    const std::vector<std::size_t> &blocks, const std::vector<std::size_t> &surfaces,
+    Cell &c)
 {
-  if (i == nX - 1)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the previous cell
-    return (meshX.deltas[i] + meshX.deltas[i - 1])/2.0;
+  // Set Cell Properties
+  c.density = foundation.soil.density;
+  c.specificHeat = foundation.soil.specificHeat;
+  c.conductivity = foundation.soil.conductivity;
+  c.heatGain = 0.0;
+
+  // Default to normal cells
+  c.cellType = Cell::NORMAL;
+  c.blockNumber = -1;
+  c.surfaceNumber = -1;
+  c.boundaryIndex = -1;
+
+  // Next set interior zero-width cells
+  if (foundation.numberOfDimensions == 3)
+  {
+    if (isEqual(meshX.deltas[i], 0.0) ||
+      isEqual(meshZ.deltas[k], 0.0) ||
+      isEqual(meshY.deltas[j], 0.0))
+    {
+      c.cellType = Cell::ZERO_THICKNESS;
+    }
   }
   else
   {
-    return (meshX.deltas[i] + meshX.deltas[i + 1])/2.0;
+    if (isEqual(meshX.deltas[i], 0.0) ||
+      isEqual(meshZ.deltas[k], 0.0))
+    {
+      c.cellType = Cell::ZERO_THICKNESS;
+    }
   }
-}
 
-double Domain::getDXM(std::size_t i)
-{
-  if (i == 0)
+  for (std::size_t cb = 0; cb < blocks.size(); cb++)
   {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the previous cell
-    return (meshX.deltas[i] + meshX.deltas[i + 1])/2.0;
-  }
-  else
-  {
-    return (meshX.deltas[i] + meshX.deltas[i - 1])/2.0;
-  }
-}
+    std::size_t b = blocks[cb];
+    if (isGreaterThan(meshZ.centers[k], foundation.blocks[b].zMin) &&
+      isLessThan(meshZ.centers[k], foundation.blocks[b].zMax))
+    {
+      c.density = foundation.blocks[b].material.density;
+      c.specificHeat = foundation.blocks[b].material.specificHeat;
+      c.conductivity = foundation.blocks[b].material.conductivity;
 
-double Domain::getDYP(std::size_t j)
-{
-  if (j == nY - 1)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the previous cell
-    return (meshY.deltas[j] + meshY.deltas[j - 1])/2.0;
-  }
-  else
-  {
-    return (meshY.deltas[j] + meshY.deltas[j + 1])/2.0;
-  }
-}
+      c.blockNumber = b;
 
-double Domain::getDYM(std::size_t j)
-{
-  if (j == 0)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the previous cell
-    return (meshY.deltas[j] + meshY.deltas[j + 1])/2.0;
-  }
-  else
-  {
-    return (meshY.deltas[j] + meshY.deltas[j - 1])/2.0;
-  }
-}
 
-double Domain::getDZP(std::size_t k)
-{
-  if (k == nZ - 1)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the previous cell
-    return (meshZ.deltas[k] + meshZ.deltas[k - 1])/2.0;
-  }
-  else
-  {
-    return (meshZ.deltas[k] + meshZ.deltas[k + 1])/2.0;
+      if (foundation.blocks[b].blockType == Block::INTERIOR_AIR)
+      {
+        c.cellType = Cell::INTERIOR_AIR;
+      }
+      else if (foundation.blocks[b].blockType == Block::EXTERIOR_AIR)
+      {
+        c.cellType = Cell::EXTERIOR_AIR;
+      }
+    }
   }
-}
 
-double Domain::getDZM(std::size_t k)
-{
-  if (k == 0)
+  for (std::size_t cs = 0; cs < surfaces.size(); cs++)
   {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the previous cell
-    return (meshZ.deltas[k] + meshZ.deltas[k + 1])/2.0;
-  }
-  else
-  {
-    return (meshZ.deltas[k] + meshZ.deltas[k - 1])/2.0;
-  }
-}
+    std::size_t s = surfaces[cs];
+    if (isGreaterOrEqual(meshZ.centers[k], foundation.surfaces[s].zMin)
+    &&  isLessOrEqual(meshZ.centers[k], foundation.surfaces[s].zMax))
+    {
+      c.cellType = Cell::BOUNDARY;
 
-double Domain::getKXP(std::size_t i, std::size_t j, std::size_t k)
-{
-  if (i == nX - 1)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the current cell
-    return cell[i][j][k].conductivity;
-  }
-  else
-  {
-    return 1/(meshX.deltas[i]/(2*getDXP(i)*cell[i][j][k].conductivity) +
-        meshX.deltas[i + 1]/(2*getDXP(i)*cell[i+1][j][k].conductivity));
-  }
-}
+      c.surfaceNumber = s;
 
-double Domain::getKXM(std::size_t i, std::size_t j, std::size_t k)
-{
-  if (i == 0)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the current cell
-    return cell[i][j][k].conductivity;
-  }
-  else
-  {
-    return 1/(meshX.deltas[i]/(2*getDXM(i)*cell[i][j][k].conductivity) +
-        meshX.deltas[i - 1]/(2*getDXM(i)*cell[i-1][j][k].conductivity));
-  }
-}
+      // Point/Line cells not on the boundary should be
+      // zero-thickness cells
+      int numZeroDims = getNumZeroDims(i,j,k);
 
-double Domain::getKYP(std::size_t i, std::size_t j, std::size_t k)
-{
-  if (j == nY - 1)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the current cell
-    return cell[i][j][k].conductivity;
+      if (foundation.numberOfDimensions == 3)
+      {
+        if ((numZeroDims > 1) &&
+          i != 0 && i != nX - 1 &&
+          j != 0 && j != nY - 1 &&
+          k != 0 && k != nZ - 1)
+          c.cellType = Cell::ZERO_THICKNESS;
+      }
+      else
+      {
+        if ((numZeroDims > 1) &&
+          i != 0 && i != nX - 1 &&
+          k != 0 && k != nZ - 1)
+          c.cellType = Cell::ZERO_THICKNESS;
+      }
+    }
   }
-  else
+
+  // Set cell volume
+  c.volume = meshX.deltas[i]*meshY.deltas[j]*meshZ.deltas[k];
+
+  // for boundary cells, set cell area
+  if (c.cellType == Cell::BOUNDARY)
   {
-    return 1/(meshY.deltas[j]/(2*getDYP(j)*cell[i][j][k].conductivity) +
-        meshY.deltas[j + 1]/(2*getDYP(j)*cell[i][j+1][k].conductivity));
+    Surface &surface = foundation.surfaces[c.surfaceNumber];
+
+    if (foundation.numberOfDimensions == 2 &&
+        foundation.coordinateSystem == Foundation::CS_CYLINDRICAL)
+    {
+      if (surface.orientation == Surface::X_POS ||
+        surface.orientation == Surface::X_NEG)
+      {
+        c.area = 2.0*PI*meshX.centers[i]*meshZ.deltas[k];
+      }
+      else // if (surface.orientation == Surface::Z_POS ||
+         // surface.orientation == Surface::Z_NEG)
+      {
+        c.area = PI*(meshX.dividers[i+1]*meshX.dividers[i+1] -
+      		  meshX.dividers[i]*meshX.dividers[i] );
+      }
+    }
+    else if (foundation.numberOfDimensions == 2 &&
+             foundation.coordinateSystem == Foundation::CS_CARTESIAN)
+    {
+      if (surface.orientation == Surface::X_POS ||
+        surface.orientation == Surface::X_NEG)
+      {
+        c.area = 2.0*meshZ.deltas[k]*foundation.linearAreaMultiplier;
+      }
+      else // if (surface.orientation == Surface::Z_POS ||
+         // surface.orientation == Surface::Z_NEG)
+      {
+        c.area = 2.0*meshX.deltas[i]*foundation.linearAreaMultiplier;
+      }
+    }
+    else  // if (foundation.numberOfDimensions == 3)
+    {
+      if (surface.orientation == Surface::X_POS ||
+        surface.orientation == Surface::X_NEG)
+      {
+        c.area = meshY.deltas[j]*meshZ.deltas[k];
+      }
+      else if (surface.orientation == Surface::Y_POS ||
+           surface.orientation == Surface::Y_NEG)
+      {
+        c.area = meshX.deltas[i]*meshZ.deltas[k];
+      }
+      else // if (surface.orientation == Surface::Z_POS ||
+         // surface.orientation == Surface::Z_NEG)
+      {
+        c.area = meshX.deltas[i]*meshY.deltas[j];
+      }
+
+      if (foundation.useSymmetry)
+      {
+        if (foundation.isXSymm)
+          c.area = 2*c.area;
+
+        if (foundation.isYSymm)
+          c.area = 2*c.area;
+      }
+    }
   }
 }
 
-double Domain::getKYM(std::size_t i, std::size_t j, std::size_t k)
+// Distance between the center of a cell and the center of its neighbor on
+// either side. For boundary cells assume that the cell on the other side of
+// the boundary is the same as the adjacent interior cell.
+static void setSpacing(const Mesher &mesh, std::vector<double> &dp,
+    std::vector<double> &dm)
 {
-  if (j == 0)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the current cell
-    return cell[i][j][k].conductivity;
-  }
-  else
+  std::size_t n = mesh.centers.size();
+  dp.resize(n);
+  dm.resize(n);
+
+  for (std::size_t i = 0; i < n; i++)
   {
-    return 1/(meshY.deltas[j]/(2*getDYM(j)*cell[i][j][k].conductivity) +
-        meshY.deltas[j - 1]/(2*getDYM(j)*cell[i][j-1][k].conductivity));
+    if (n == 1)
+    {
+      dp[i] = mesh.deltas[i];
+      dm[i] = mesh.deltas[i];
+      continue;
+    }
+
+    if (i == n - 1)
+      dp[i] = (mesh.deltas[i] + mesh.deltas[i - 1])/2.0;
+    else
+      dp[i] = (mesh.deltas[i] + mesh.deltas[i + 1])/2.0;
+
+    if (i == 0)
+      dm[i] = (mesh.deltas[i] + mesh.deltas[i + 1])/2.0;
+    else
+      dm[i] = (mesh.deltas[i] + mesh.deltas[i - 1])/2.0;
   }
 }
 
-double Domain::getKZP(std::size_t i, std::size_t j, std::size_t k)
+void Domain::setSpacings()
 {
-  if (k == nZ - 1)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the current cell
-    return cell[i][j][k].conductivity;
-  }
-  else
-  {
-    return 1/(meshZ.deltas[k]/(2*getDZP(k)*cell[i][j][k].conductivity) +
-        meshZ.deltas[k + 1]/(2*getDZP(k)*cell[i][j][k+1].conductivity));
-  }
+  setSpacing(meshX, dxp, dxm);
+  setSpacing(meshY, dyp, dym);
+  setSpacing(meshZ, dzp, dzm);
 }
 
-double Domain::getKZM(std::size_t i, std::size_t j, std::size_t k)
+void Domain::setConductances()
 {
-  if (k == 0)
-  {
-    // For boundary cells assume that the cell on the other side of the
-    // boundary is the same as the current cell
-    return cell[i][j][k].conductivity;
-  }
-  else
+  std::size_t nI = iLast - iFirst;
+  kx.assign((nI + 1)*nY*nZ, 0.0);
+  ky.assign(nI*(nY + 1)*nZ, 0.0);
+  kz.assign(nI*nY*(nZ + 1), 0.0);
+
+  for (std::size_t i = iFirst; i < iLast; i++)
   {
-    return 1/(meshZ.deltas[k]/(2*getDZM(k)*cell[i][j][k].conductivity) +
-        meshZ.deltas[k - 1]/(2*getDZM(k)*cell[i][j][k-1].conductivity));
+    std::size_t n = i - iFirst;  // position among the stored columns
+    for (std::size_t j = 0; j < nY; j++)
+    {
+      for (std::size_t k = 0; k < nZ; k++)
+      {
+        double kth = cell[i][j][k].conductivity;
+
+        // Faces on the domain boundary assume that the cell on the other side
+        // of the boundary is the same as the current cell. Interior faces use
+        // the harmonic mean of the two cells sharing the face. (Faces on the
+        // outside of the stored columns are treated like the domain boundary;
+        // the cells next to them are only kept for their temperatures.)
+        if (i == iFirst)
+          kx[(n*nY + j)*nZ + k] = kth;
+        if (i == iLast - 1)
+          kx[((n + 1)*nY + j)*nZ + k] = kth;
+        else
+          kx[((n + 1)*nY + j)*nZ + k] =
+              1/(meshX.deltas[i]/(2*dxp[i]*kth) +
+              meshX.deltas[i + 1]/(2*dxp[i]*cell[i+1][j][k].conductivity));
+
+        if (j == 0)
+          ky[(n*(nY + 1) + j)*nZ + k] = kth;
+        if (j == nY - 1)
+          ky[(n*(nY + 1) + j + 1)*nZ + k] = kth;
+        else
+          ky[(n*(nY + 1) + j + 1)*nZ + k] =
+              1/(meshY.deltas[j]/(2*dyp[j]*kth) +
+              meshY.deltas[j + 1]/(2*dyp[j]*cell[i][j+1][k].conductivity));
+
+        if (k == 0)
+          kz[(n*nY + j)*(nZ + 1) + k] = kth;
+        if (k == nZ - 1)
+          kz[(n*nY + j)*(nZ + 1) + k + 1] = kth;
+        else
+          kz[(n*nY + j)*(nZ + 1) + k + 1] =
+              1/(meshZ.deltas[k]/(2*dzp[k]*kth) +
+              meshZ.deltas[k + 1]/(2*dzp[k]*cell[i][j][k+1].conductivity));
+      }
+    }
   }
 }
 
@@ -20,23 +20,23 @@ class Cell
 public:
 
   // inherent properties
-  double density;
-  double specificHeat;
-  double conductivity;
+  StorageType density;
+  StorageType specificHeat;
+  StorageType conductivity;
 
-  double volume;
-  double area;
-  double heatGain;
+  StorageType volume;
+  StorageType area;
+  StorageType heatGain;
 
   // derived properties
-  double cxp_c;
-  double cxm_c;
-  double cxp;
-  double cxm;
-  double cyp;
-  double cym;
-  double czp;
-  double czm;
+  StorageType cxp_c;
+  StorageType cxm_c;
+  StorageType cxp;
+  StorageType cxm;
+  StorageType cyp;
+  StorageType cym;
+  StorageType czp;
+  StorageType czm;
 
   // organizational properties
   enum CellType
@@ -49,11 +49,12 @@ public:
   };
   CellType cellType;
 
-  //size_t blockNumber;
-  Block block;
+  // Indices into Foundation::blocks and Foundation::surfaces (-1 if none)
+  int blockNumber;
+  int surfaceNumber;
 
-  //size_t surfaceNumber;
-  Surface surface;
+  // Position in Ground's list of convective boundary cells (-1 if none)
+  int boundaryIndex;
 };
 
 class Domain
@@ -68,25 +69,47 @@ public:
     std::size_t nY;
     std::size_t nZ;
 
+    // Cells are stored for the columns [iFirst, iLast) in the x-direction
+    // (all columns unless the domain is divided among processes). Other
+    // columns of cell are empty, so cells keep their domain indices.
+    std::size_t iFirst, iLast;
     std::vector<std::vector<std::vector<Cell>>> cell;
 
+    // Distances between neighboring cell centers along each axis
+    std::vector<double> dxp, dxm, dyp, dym, dzp, dzm;
+
+    // Effective conductivity of each cell face of the stored columns, indexed
+    // by the face position along its axis (iLast - iFirst + 1 faces in x for
+    // each j,k, etc.)
+    std::vector<StorageType> kx, ky, kz;
+
 public:
 
     Domain();
     Domain(Foundation &foundation);
     void setDomain(Foundation &foundation);
-    double getDXP(std::size_t i);
-    double getDXM(std::size_t i);
-    double getDYP(std::size_t j);
-    double getDYM(std::size_t j);
-    double getDZP(std::size_t k);
-    double getDZM(std::size_t k);
-    double getKXP(std::size_t i,std::size_t j,std::size_t k);
-    double getKXM(std::size_t i,std::size_t j,std::size_t k);
-    double getKYP(std::size_t i,std::size_t j,std::size_t k);
-    double getKYM(std::size_t i,std::size_t j,std::size_t k);
-    double getKZP(std::size_t i,std::size_t j,std::size_t k);
-    double getKZM(std::size_t i,std::size_t j,std::size_t k);
+
+    // setDomain in two steps: the mesh, then the cells of the stored columns
+    // (surface indices and areas are always set for the whole domain)
+    void setMesh(Foundation &foundation);
+    void setCells(Foundation &foundation, std::size_t iFirst, std::size_t iLast);
+    void setCell(Foundation &foundation, std::size_t i, std::size_t j, std::size_t k,
+        const std::vector<std::size_t> &blocks, const std::vector<std::size_t> &surfaces,
+        Cell &c);
+    void setSpacings();
+    void setConductances();
+    double getDXP(std::size_t i) {return dxp[i];}
+    double getDXM(std::size_t i) {return dxm[i];}
+    double getDYP(std::size_t j) {return dyp[j];}
+    double getDYM(std::size_t j) {return dym[j];}
+    double getDZP(std::size_t k) {return dzp[k];}
+    double getDZM(std::size_t k) {return dzm[k];}
+    double getKXP(std::size_t i,std::size_t j,std::size_t k) {return kx[((i - iFirst + 1)*nY + j)*nZ + k];}
+    double getKXM(std::size_t i,std::size_t j,std::size_t k) {return kx[((i - iFirst)*nY + j)*nZ + k];}
+    double getKYP(std::size_t i,std::size_t j,std::size_t k) {return ky[((i - iFirst)*(nY + 1) + j + 1)*nZ + k];}
+    double getKYM(std::size_t i,std::size_t j,std::size_t k) {return ky[((i - iFirst)*(nY + 1) + j)*nZ + k];}
+    double getKZP(std::size_t i,std::size_t j,std::size_t k) {return kz[((i - iFirst)*nY + j)*(nZ + 1) + k + 1];}
+    double getKZM(std::size_t i,std::size_t j,std::size_t k) {return kz[((i - iFirst)*nY + j)*(nZ + 1) + k];}
     int getNumZeroDims(std::size_t i,std::size_t j,std::size_t k);
     void set2DZeroThicknessCellProperties(std::size_t i,std::size_t j,std::size_t k);
     void set3DZeroThicknessCellProperties(std::size_t i,std::size_t j,std::size_t k);
@@ -84,6 +84,7 @@ void Foundation::createMeshData()
 {
   std::size_t nV = polygon.outer().size();
 
+  buildingSurfaces.clear();
   for (std::size_t v = 0; v < nV; v++)
   {
     double thisX = polygon.outer()[v].get<0>();
@@ -260,6 +260,11 @@ public:
   double buildingHeight;
   std::vector<Polygon3> buildingSurfaces;
 
+  // Ray-traced exterior shading by the building surfaces
+  bool exteriorShading;
+  double shadingAngularResolution;  // [radians] sun position bin size
+  int shadingSamples;  // samples across each side of a boundary cell
+
   // Constructions
   Wall wall;
   bool hasWall;
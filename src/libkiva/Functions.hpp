@@ -13,6 +13,15 @@
 
 namespace Kiva {
 
+// Storage type of temperature fields and cell properties. Building with
+// ENABLE_SINGLE_PRECISION halves the memory traffic of the domain
+// calculations; arithmetic (and the linear solvers) remain double precision.
+#ifdef ENABLE_SINGLE_PRECISION
+typedef float StorageType;
+#else
+typedef double StorageType;
+#endif
+
 bool LIBKIVA_EXPORT isLessThan(double first, double second);
 bool LIBKIVA_EXPORT isLessOrEqual(double first, double second);
 bool LIBKIVA_EXPORT isEqual(double first, double second);
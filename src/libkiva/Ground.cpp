@@ -6,19 +6,34 @@
 
 #include "Ground.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+#if defined(ENABLE_OPENGL)
+#include "PixelCounter.hpp"
+#endif
+
 namespace Kiva {
 
 static const double PI = 4.0*atan(1.0);
 
 static const bool TDMA = true;
 
-Ground::Ground(Foundation &foundation) : foundation(foundation)
+// Columns of the neighboring slabs stored by each process of a distributed
+// domain. The explicit scheme only reads the adjacent column, but the heat
+// flux of a zero-thickness cell uses the heat flux of its neighbors.
+static const std::size_t haloWidth = 2;
+
+Ground::Ground(Foundation &foundation) : foundation(foundation), timer(NULL),
+  distributed(false)
 {
 
 }
 
 Ground::Ground(Foundation &foundation, GroundOutput::OutputMap &outputMap)
-  : foundation(foundation), groundOutput(outputMap)
+  : foundation(foundation), groundOutput(outputMap), timer(NULL),
+    distributed(false)
 {
 
 }
@@ -29,28 +44,66 @@ Ground::~Ground()
   lis_vector_destroy(x);
   lis_vector_destroy(b);
   lis_solver_destroy(solver); // for whatever reason, this causes a crash
+  for (std::size_t m = 0; m < ensembleX.size(); m++)
+    lis_vector_destroy(ensembleX[m]);
 }
 
 void Ground::buildDomain()
 {
   // Create mesh
-  foundation.createMeshData();
+  {
+    PhaseTimer::Scope scope(timer, PhaseTimer::PH_MESH);
+    foundation.createMeshData();
+  }
 
-  // Build matrices for PDE term coefficients
-  domain.setDomain(foundation);
+  PhaseTimer::Scope scope(timer, PhaseTimer::PH_DOMAIN);
+  Tracer::Scope trace("Build domain");
+
+  domain.setMesh(foundation);
 
   nX = domain.meshX.centers.size();
   nY = domain.meshY.centers.size();
   nZ = domain.meshZ.centers.size();
 
+  iBegin = 0;
+  iEnd = nX;
+  iStoredBegin = 0;
+  iStoredEnd = nX;
+
+#ifdef ENABLE_MPI
+  if (distributed)
+  {
+    // Each slab must be at least as wide as the halo, so any processes
+    // beyond nX/haloWidth are left without cells
+    std::size_t nActive = std::max(std::min(std::size_t(nProcs), nX/haloWidth), std::size_t(1));
+
+    slabBegin.resize(nProcs + 1);
+    for (int r = 0; r <= nProcs; r++)
+      slabBegin[r] = std::min(std::size_t(r), nActive)*nX/nActive;
+
+    iBegin = slabBegin[rank];
+    iEnd = slabBegin[rank + 1];
+    iStoredBegin = iBegin;
+    iStoredEnd = iEnd;
+    if (iBegin < iEnd)
+    {
+      iStoredBegin = iBegin >= haloWidth ? iBegin - haloWidth : 0;
+      iStoredEnd = std::min(iEnd + haloWidth, nX);
+    }
+  }
+#endif
+
+  // Build matrices for PDE term coefficients
+  domain.setCells(foundation, iStoredBegin, iStoredEnd);
+
   // Initialize matices
   if (foundation.numericalScheme == Foundation::NS_ADE)
   {
-    U.resize(nX,std::vector<std::vector<double> >(nY,std::vector<double>(nZ)));
-    UOld.resize(nX,std::vector<std::vector<double> >(nY,std::vector<double>(nZ)));
+    U.resize(nX,std::vector<std::vector<StorageType> >(nY,std::vector<StorageType>(nZ)));
+    UOld.resize(nX,std::vector<std::vector<StorageType> >(nY,std::vector<StorageType>(nZ)));
 
-    V.resize(nX,std::vector<std::vector<double> >(nY,std::vector<double>(nZ)));
-    VOld.resize(nX,std::vector<std::vector<double> >(nY,std::vector<double>(nZ)));
+    V.resize(nX,std::vector<std::vector<StorageType> >(nY,std::vector<StorageType>(nZ)));
+    VOld.resize(nX,std::vector<std::vector<StorageType> >(nY,std::vector<StorageType>(nZ)));
   }
 
   if (foundation.numericalScheme == Foundation::NS_ADI && TDMA)
@@ -75,24 +128,200 @@ void Ground::buildDomain()
   solverChars.push_back('\0');
   solverOptions = solverChars;
 
-  lis_matrix_create(LIS_COMM_WORLD,&Amat);
-  lis_matrix_set_size(Amat,nX*nY*nZ,nX*nY*nZ);
+  // The iterative solvers are only used by the implicit schemes, which are
+  // not calculated on a distributed domain
+  if (distributed)
+  {
+    Amat = NULL;
+    b = NULL;
+    x = NULL;
+    solver = NULL;
+  }
+  else
+  {
+    lis_matrix_create(LIS_COMM_WORLD,&Amat);
+    lis_matrix_set_size(Amat,nX*nY*nZ,nX*nY*nZ);
+
+    lis_vector_create(LIS_COMM_WORLD,&b);
+    lis_vector_set_size(b,0,nX*nY*nZ);
+
+    lis_vector_duplicate(b,&x);
+
+    lis_vector_set_all(283.15,x);  // TODO Set better default
+    lis_solver_create(&solver);
+    lis_solver_set_option(&solverOptions[0],solver);
+  }
+
+  TNew.resize(nX);
+  TOld.resize(nX);
+  for (std::size_t i = iStoredBegin; i < iStoredEnd; i++)
+  {
+    TNew[i].resize(nY,std::vector<StorageType>(nZ));
+    TOld[i].resize(nY,std::vector<StorageType>(nZ));
+  }
+
+  matrixRows.clear();
+  csrPtr.clear();
+  csrIndex.clear();
+  csrValue.clear();
+  matrixInteriorCurrent = false;
+
+  compileSurfaceAverages();
+  compileBoundaryCells();
+  compileShading();
+}
+
+bool Ground::isDistributed()
+{
+  return distributed;
+}
+
+#ifdef ENABLE_MPI
+bool Ground::distribute(MPI_Comm communicator)
+{
+  comm = communicator;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nProcs);
+
+  if (nProcs == 1)
+    return true;
+
+  if (foundation.numericalScheme != Foundation::NS_EXPLICIT)
+    return false;
+
+  distributed = true;
+  return true;
+}
+
+void Ground::exchangeHalos()
+{
+  Tracer::Scope trace("Halo exchange");
+
+  // Processes without cells have no neighbors
+  if (iBegin == iEnd)
+    return;
+
+  std::size_t nYZ = nY*nZ;
+  std::size_t nHalo = haloWidth*nYZ;
+  std::vector<double> sendBuffer(nHalo), recvBuffer(nHalo);
 
-  lis_vector_create(LIS_COMM_WORLD,&b);
-  lis_vector_set_size(b,0,nX*nY*nZ);
+  int left = iBegin > 0 ? rank - 1 : MPI_PROC_NULL;
+  int right = iEnd < nX ? rank + 1 : MPI_PROC_NULL;
 
-  lis_vector_duplicate(b,&x);
+  // Send first owned columns left, receive right halo
+  for (size_t i = 0; i < haloWidth; ++i)
+    for (size_t j = 0; j < nY; ++j)
+      std::copy(TOld[iBegin + i][j].begin(), TOld[iBegin + i][j].end(), sendBuffer.begin() + i*nYZ + j*nZ);
 
-  lis_vector_set_all(283.15,x);  // TODO Set better default
-  lis_solver_create(&solver);
-  lis_solver_set_option(&solverOptions[0],solver);
+  MPI_Sendrecv(&sendBuffer[0], nHalo, MPI_DOUBLE, left, 0,
+               &recvBuffer[0], nHalo, MPI_DOUBLE, right, 0, comm, MPI_STATUS_IGNORE);
 
-  TNew.resize(nX,std::vector<std::vector<double> >(nY,std::vector<double>(nZ)));
-  TOld.resize(nX,std::vector<std::vector<double> >(nY,std::vector<double>(nZ)));
+  if (right != MPI_PROC_NULL)
+  {
+    for (size_t i = 0; i < haloWidth; ++i)
+    {
+      for (size_t j = 0; j < nY; ++j)
+      {
+        std::copy(recvBuffer.begin() + i*nYZ + j*nZ, recvBuffer.begin() + i*nYZ + (j+1)*nZ, TOld[iEnd + i][j].begin());
+        TNew[iEnd + i][j] = TOld[iEnd + i][j];
+      }
+    }
+  }
+
+  // Send last owned columns right, receive left halo
+  for (size_t i = 0; i < haloWidth; ++i)
+    for (size_t j = 0; j < nY; ++j)
+      std::copy(TOld[iEnd - haloWidth + i][j].begin(), TOld[iEnd - haloWidth + i][j].end(), sendBuffer.begin() + i*nYZ + j*nZ);
+
+  MPI_Sendrecv(&sendBuffer[0], nHalo, MPI_DOUBLE, right, 1,
+               &recvBuffer[0], nHalo, MPI_DOUBLE, left, 1, comm, MPI_STATUS_IGNORE);
+
+  if (left != MPI_PROC_NULL)
+  {
+    for (size_t i = 0; i < haloWidth; ++i)
+    {
+      for (size_t j = 0; j < nY; ++j)
+      {
+        std::copy(recvBuffer.begin() + i*nYZ + j*nZ, recvBuffer.begin() + i*nYZ + (j+1)*nZ, TOld[iBegin - haloWidth + i][j].begin());
+        TNew[iBegin - haloWidth + i][j] = TOld[iBegin - haloWidth + i][j];
+      }
+    }
+  }
+}
+
+void Ground::gatherBlock(std::size_t iMin, std::size_t iMax, std::size_t nJK,
+                         const std::vector<double> &local, double *values)
+{
+  Tracer::Scope trace("Gather block");
+
+  // Columns of the block owned by each process
+  std::vector<std::size_t> iLo(nProcs), nI(nProcs);
+  std::vector<int> counts(nProcs), displacements(nProcs);
+  int total = 0;
+  for (int r = 0; r < nProcs; r++)
+  {
+    iLo[r] = std::max(iMin, slabBegin[r]);
+    std::size_t iHi = std::min(iMax + 1, slabBegin[r + 1]);
+    nI[r] = iHi > iLo[r] ? iHi - iLo[r] : 0;
+    counts[r] = nI[r]*nJK;
+    displacements[r] = total;
+    total += counts[r];
+  }
+
+  std::vector<double> received(rank == 0 ? total : 0);
+  MPI_Gatherv(local.empty() ? NULL : &local[0], counts[rank], MPI_DOUBLE,
+              received.empty() ? NULL : &received[0], &counts[0], &displacements[0],
+              MPI_DOUBLE, 0, comm);
+
+  if (rank != 0)
+    return;
+
+  std::size_t nIBlock = iMax - iMin + 1;
+  for (int r = 0; r < nProcs; r++)
+    for (std::size_t jk = 0; jk < nJK; jk++)
+      std::copy(received.begin() + displacements[r] + jk*nI[r],
+                received.begin() + displacements[r] + (jk + 1)*nI[r],
+                values + (iLo[r] - iMin) + jk*nIBlock);
+}
+#endif
+
+std::vector<double> Ground::gatherField(const std::vector<std::vector<std::vector<StorageType>>> &T)
+{
+  Tracer::Scope trace("Gather field");
+  std::size_t nYZ = nY*nZ;
+
+  // Columns owned by this process
+  std::vector<double> local((iEnd - iBegin)*nYZ);
+  for (size_t i = iBegin; i < iEnd; ++i)
+    for (size_t j = 0; j < nY; ++j)
+      std::copy(T[i][j].begin(), T[i][j].end(), local.begin() + (i - iBegin)*nYZ + j*nZ);
+
+  if (!distributed)
+    return local;
+
+  std::vector<double> global;
+#ifdef ENABLE_MPI
+  std::vector<int> counts(nProcs), displacements(nProcs);
+  for (int r = 0; r < nProcs; r++)
+  {
+    counts[r] = (slabBegin[r + 1] - slabBegin[r])*nYZ;
+    displacements[r] = slabBegin[r]*nYZ;
+  }
+
+  if (rank == 0)
+    global.resize(nX*nYZ);
+  MPI_Gatherv(local.empty() ? NULL : &local[0], counts[rank], MPI_DOUBLE,
+              global.empty() ? NULL : &global[0], &counts[0], &displacements[0],
+              MPI_DOUBLE, 0, comm);
+#endif
+
+  return global;
 }
 
 void Ground::calculateADE()
 {
+  calculateBoundaryCoefficients();
+
   // Set Old values
   for (size_t i = 0; i < nX; ++i)
   {
@@ -133,6 +362,7 @@ void Ground::calculateADE()
 
 void Ground::calculateADEUpwardSweep()
 {
+  Tracer::Scope trace("ADE upward sweep");
   // Upward sweep (Solve U Matrix starting from 1, 1)
   for (size_t i = 0; i < nX; i++)
   {
@@ -144,19 +374,20 @@ void Ground::calculateADEUpwardSweep()
         {
         case Cell::BOUNDARY:
           {
+          Surface &surface = foundation.surfaces[domain.cell[i][j][k].surfaceNumber];
           double tilt;
-          if (domain.cell[i][j][k].surface.orientation == Surface::Z_POS)
+          if (surface.orientation == Surface::Z_POS)
             tilt = 0;
-          else if (domain.cell[i][j][k].surface.orientation == Surface::Z_NEG)
+          else if (surface.orientation == Surface::Z_NEG)
             tilt = PI;
           else
             tilt = PI/2.0;
 
-          switch (domain.cell[i][j][k].surface.boundaryConditionType)
+          switch (surface.boundaryConditionType)
           {
           case Surface::ZERO_FLUX:
             {
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               U[i][j][k] = UOld[i+1][j][k];
@@ -182,7 +413,7 @@ void Ground::calculateADEUpwardSweep()
 
           case Surface::CONSTANT_TEMPERATURE:
 
-            U[i][j][k] = domain.cell[i][j][k].surface.temperature;
+            U[i][j][k] = surface.temperature;
             break;
 
           case Surface::INTERIOR_TEMPERATURE:
@@ -200,12 +431,10 @@ void Ground::calculateADEUpwardSweep()
             double Tair = bcs.indoorTemp;
             double q = domain.cell[i][j][k].heatGain;
 
-            double hc = getConvectionCoeff(TOld[i][j][k],
-                    Tair,0.0,1.52,false,tilt);
-            double hr = getSimpleInteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,
-                               TOld[i][j][k],Tair);
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               U[i][j][k] = (domain.getKXP(i,j,k)*UOld[i+1][j][k]/domain.getDXP(i) +
@@ -238,14 +467,13 @@ void Ground::calculateADEUpwardSweep()
           case Surface::EXTERIOR_FLUX:
             {
             double Tair = bcs.outdoorTemp;
-            double v = bcs.localWindSpeed;
             double eSky = bcs.skyEmissivity;
             double F = getEffectiveExteriorViewFactor(eSky,tilt);
-            double hc = getConvectionCoeff(TOld[i][j][k],Tair,v,foundation.surfaceRoughness,true,tilt);
-            double hr = getExteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,TOld[i][j][k],Tair,eSky,tilt);
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
             double q = domain.cell[i][j][k].heatGain;
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               U[i][j][k] = (domain.getKXP(i,j,k)*UOld[i+1][j][k]/domain.getDXP(i) +
@@ -335,6 +563,7 @@ void Ground::calculateADEUpwardSweep()
 
 void Ground::calculateADEDownwardSweep()
 {
+  Tracer::Scope trace("ADE downward sweep");
   // Downward sweep (Solve V Matrix starting from I, K)
   for (size_t i = nX - 1; i >= 0 && i < nX; i--)
   {
@@ -346,19 +575,20 @@ void Ground::calculateADEDownwardSweep()
         {
         case Cell::BOUNDARY:
           {
+          Surface &surface = foundation.surfaces[domain.cell[i][j][k].surfaceNumber];
           double tilt;
-          if (domain.cell[i][j][k].surface.orientation == Surface::Z_POS)
+          if (surface.orientation == Surface::Z_POS)
             tilt = 0;
-          else if (domain.cell[i][j][k].surface.orientation == Surface::Z_NEG)
+          else if (surface.orientation == Surface::Z_NEG)
             tilt = PI;
           else
             tilt = PI/2.0;
 
-          switch (domain.cell[i][j][k].surface.boundaryConditionType)
+          switch (surface.boundaryConditionType)
           {
           case Surface::ZERO_FLUX:
             {
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               V[i][j][k] = V[i+1][j][k];
@@ -384,7 +614,7 @@ void Ground::calculateADEDownwardSweep()
 
           case Surface::CONSTANT_TEMPERATURE:
 
-            V[i][j][k] = domain.cell[i][j][k].surface.temperature;
+            V[i][j][k] = surface.temperature;
             break;
 
           case Surface::INTERIOR_TEMPERATURE:
@@ -402,12 +632,10 @@ void Ground::calculateADEDownwardSweep()
             double& Tair = bcs.indoorTemp;
             double q = 0;
 
-            double hc = getConvectionCoeff(TOld[i][j][k],
-                    Tair,0.0,1.52,false,tilt);
-            double hr = getSimpleInteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,
-                               TOld[i][j][k],Tair);
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               V[i][j][k] = (domain.getKXP(i,j,k)*V[i+1][j][k]/domain.getDXP(i) +
@@ -440,14 +668,13 @@ void Ground::calculateADEDownwardSweep()
           case Surface::EXTERIOR_FLUX:
             {
             double& Tair = bcs.outdoorTemp;
-            double& v = bcs.localWindSpeed;
             double& eSky = bcs.skyEmissivity;
             double F = getEffectiveExteriorViewFactor(eSky,tilt);
-            double hc = getConvectionCoeff(TOld[i][j][k],Tair,v,foundation.surfaceRoughness,true,tilt);
-            double hr = getExteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,TOld[i][j][k],Tair,eSky,tilt);
-            double q = domain.cell[i][j][k].surface.absorptivity*bcs.globalHorizontalFlux;
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
+            double q = surface.absorptivity*bcs.globalHorizontalFlux;
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               V[i][j][k] = (domain.getKXP(i,j,k)*V[i+1][j][k]/domain.getDXP(i) +
@@ -538,7 +765,10 @@ void Ground::calculateADEDownwardSweep()
 
 void Ground::calculateExplicit()
 {
-  for (size_t i = 0; i < nX; i++)
+  Tracer::Scope trace("Explicit scheme");
+  calculateBoundaryCoefficients();
+
+  for (size_t i = iBegin; i < iEnd; i++)
   {
     for (size_t j = 0; j < nY; ++j)
     {
@@ -548,19 +778,20 @@ void Ground::calculateExplicit()
         {
         case Cell::BOUNDARY:
           {
+          Surface &surface = foundation.surfaces[domain.cell[i][j][k].surfaceNumber];
           double tilt;
-          if (domain.cell[i][j][k].surface.orientation == Surface::Z_POS)
+          if (surface.orientation == Surface::Z_POS)
             tilt = 0;
-          else if (domain.cell[i][j][k].surface.orientation == Surface::Z_NEG)
+          else if (surface.orientation == Surface::Z_NEG)
             tilt = PI;
           else
             tilt = PI/2.0;
 
-          switch (domain.cell[i][j][k].surface.boundaryConditionType)
+          switch (surface.boundaryConditionType)
           {
           case Surface::ZERO_FLUX:
             {
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               TNew[i][j][k] = TOld[i+1][j][k];
@@ -586,7 +817,7 @@ void Ground::calculateExplicit()
 
           case Surface::CONSTANT_TEMPERATURE:
 
-            TNew[i][j][k] = domain.cell[i][j][k].surface.temperature;
+            TNew[i][j][k] = surface.temperature;
             break;
 
           case Surface::INTERIOR_TEMPERATURE:
@@ -604,12 +835,10 @@ void Ground::calculateExplicit()
             double& Tair = bcs.indoorTemp;
             double q = 0;
 
-            double hc = getConvectionCoeff(TOld[i][j][k],
-                    Tair,0.0,1.52,false,tilt);
-            double hr = getSimpleInteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,
-                               TOld[i][j][k],Tair);
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               TNew[i][j][k] = (domain.getKXP(i,j,k)*TOld[i+1][j][k]/domain.getDXP(i) +
@@ -642,14 +871,13 @@ void Ground::calculateExplicit()
           case Surface::EXTERIOR_FLUX:
             {
             double& Tair = bcs.outdoorTemp;
-            double& v = bcs.localWindSpeed;
             double& eSky = bcs.skyEmissivity;
             double F = getEffectiveExteriorViewFactor(eSky,tilt);
-            double hc = getConvectionCoeff(TOld[i][j][k],Tair,v,foundation.surfaceRoughness,true,tilt);
-            double hr = getExteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,TOld[i][j][k],Tair,eSky,tilt);
-            double q = domain.cell[i][j][k].surface.absorptivity*bcs.globalHorizontalFlux;
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
+            double q = surface.absorptivity*bcs.globalHorizontalFlux;
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               TNew[i][j][k] = (domain.getKXP(i,j,k)*TOld[i+1][j][k]/domain.getDXP(i) +
@@ -735,7 +963,7 @@ void Ground::calculateExplicit()
       }
     }
   }
-  for (size_t i = 0; i < nX; ++i)
+  for (size_t i = iBegin; i < iEnd; ++i)
   {
     for (size_t j = 0; j < nY; ++j)
     {
@@ -746,10 +974,27 @@ void Ground::calculateExplicit()
       }
     }
   }
+
+#ifdef ENABLE_MPI
+  if (distributed)
+    exchangeHalos();
+#endif
 }
 
 void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
 {
+  Tracer::Scope trace("Matrix scheme");
+  calculateBoundaryCoefficients();
+
+  // The first solution builds the structure of the matrix. Interior rows
+  // depend only on the scheme and timestep, so they are kept until either
+  // changes and shared by every timestep and ensemble member.
+  bool buildingMatrix = csrPtr.empty();
+  if (buildingMatrix)
+    matrixRows.assign(nX*nY*nZ, std::vector<std::pair<LIS_INT,double>>());
+  if (matrixInteriorCurrent && (scheme != matrixScheme || timestep != matrixTimestep))
+    matrixInteriorCurrent = false;
+
   for (size_t i = 0; i < nX; i++)
   {
     for (size_t j = 0; j < nY; j++)
@@ -770,19 +1015,20 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
         {
         case Cell::BOUNDARY:
           {
+          Surface &surface = foundation.surfaces[domain.cell[i][j][k].surfaceNumber];
           double tilt;
-          if (domain.cell[i][j][k].surface.orientation == Surface::Z_POS)
+          if (surface.orientation == Surface::Z_POS)
             tilt = 0;
-          else if (domain.cell[i][j][k].surface.orientation == Surface::Z_NEG)
+          else if (surface.orientation == Surface::Z_NEG)
             tilt = PI;
           else
             tilt = PI/2.0;
 
-          switch (domain.cell[i][j][k].surface.boundaryConditionType)
+          switch (surface.boundaryConditionType)
           {
           case Surface::ZERO_FLUX:
             {
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               A = 1.0;
@@ -843,7 +1089,7 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
             break;
           case Surface::CONSTANT_TEMPERATURE:
             A = 1.0;
-            bVal = domain.cell[i][j][k].surface.temperature;
+            bVal = surface.temperature;
 
             setAmatValue(index,index,A);
             setbValue(index,bVal);
@@ -867,12 +1113,10 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
             double Tair = bcs.indoorTemp;
             double q = 0;
 
-            double hc = getConvectionCoeff(TOld[i][j][k],
-                    Tair,0.0,1.52,false,tilt);
-            double hr = getSimpleInteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,
-                               TOld[i][j][k],Tair);
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               A = domain.getKXP(i,j,k)/domain.getDXP(i) + (hc + hr);
@@ -935,14 +1179,13 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
           case Surface::EXTERIOR_FLUX:
             {
             double& Tair = bcs.outdoorTemp;
-            double& v = bcs.localWindSpeed;
             double& eSky = bcs.skyEmissivity;
             double F = getEffectiveExteriorViewFactor(eSky,tilt);
-            double hc = getConvectionCoeff(TOld[i][j][k],Tair,v,foundation.surfaceRoughness,true,tilt);
-            double hr = getExteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,TOld[i][j][k],Tair,eSky,tilt);
-            double q = domain.cell[i][j][k].surface.absorptivity*bcs.globalHorizontalFlux;
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
+            double q = surface.absorptivity*bcs.globalHorizontalFlux;
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               A = domain.getKXP(i,j,k)/domain.getDXP(i) + (hc + hr);
@@ -1032,49 +1275,57 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
 
             if (foundation.numberOfDimensions == 3)
             {
-              A = (CXM + CZM + CYM - CXP - CZP - CYP);
-              Aim = -CXM;
-              Aip = CXP;
-              Akm = -CZM;
-              Akp = CZP;
-              Ajm = -CYM;
-              Ajp = CYP;
+              if (!matrixInteriorCurrent)
+              {
+                A = (CXM + CZM + CYM - CXP - CZP - CYP);
+                Aim = -CXM;
+                Aip = CXP;
+                Akm = -CZM;
+                Akp = CZP;
+                Ajm = -CYM;
+                Ajp = CYP;
+
+                setAmatValue(index,index,A);
+                setAmatValue(index,index_ip,Aip);
+                setAmatValue(index,index_im,Aim);
+                setAmatValue(index,index_jp,Ajp);
+                setAmatValue(index,index_jm,Ajm);
+                setAmatValue(index,index_kp,Akp);
+                setAmatValue(index,index_km,Akm);
+              }
 
               bVal = -Q;
 
-              setAmatValue(index,index,A);
-              setAmatValue(index,index_ip,Aip);
-              setAmatValue(index,index_im,Aim);
-              setAmatValue(index,index_jp,Ajp);
-              setAmatValue(index,index_jm,Ajm);
-              setAmatValue(index,index_kp,Akp);
-              setAmatValue(index,index_km,Akm);
               setbValue(index,bVal);
             }
             else
             {
-              double CXPC = 0;
-              double CXMC = 0;
-
-              if (i != 0)
+              if (!matrixInteriorCurrent)
               {
-                double r = domain.meshX.centers[i];
-                CXPC = domain.cell[i][j][k].cxp_c/r;
-                CXMC = domain.cell[i][j][k].cxm_c/r;
+                double CXPC = 0;
+                double CXMC = 0;
+
+                if (i != 0)
+                {
+                  double r = domain.meshX.centers[i];
+                  CXPC = domain.cell[i][j][k].cxp_c/r;
+                  CXMC = domain.cell[i][j][k].cxm_c/r;
+                }
+                A = (CXMC + CXM + CZM - CXPC - CXP - CZP);
+                Aim = (-CXMC - CXM);
+                Aip = (CXPC + CXP);
+                Akm = -CZM;
+                Akp = CZP;
+
+                setAmatValue(index,index,A);
+                setAmatValue(index,index_ip,Aip);
+                setAmatValue(index,index_im,Aim);
+                setAmatValue(index,index_kp,Akp);
+                setAmatValue(index,index_km,Akm);
               }
-              A = (CXMC + CXM + CZM - CXPC - CXP - CZP);
-              Aim = (-CXMC - CXM);
-              Aip = (CXPC + CXP);
-              Akm = -CZM;
-              Akp = CZP;
 
               bVal = -Q;
 
-              setAmatValue(index,index,A);
-              setAmatValue(index,index_ip,Aip);
-              setAmatValue(index,index_im,Aim);
-              setAmatValue(index,index_kp,Akp);
-              setAmatValue(index,index_km,Akm);
               setbValue(index,bVal);
             }
           }
@@ -1089,23 +1340,44 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
             else
               f = 0.5;
 
+            double Q = domain.cell[i][j][k].heatGain*theta;
+
+            if (scheme == Foundation::NS_IMPLICIT && matrixInteriorCurrent)
+            {
+              // The old temperatures of the neighbors have no weight
+              bVal = TOld[i][j][k] + Q;
+
+              setbValue(index,bVal);
+              break;
+            }
+
             double CXP = domain.cell[i][j][k].cxp*theta;
             double CXM = domain.cell[i][j][k].cxm*theta;
             double CZP = domain.cell[i][j][k].czp*theta;
             double CZM = domain.cell[i][j][k].czm*theta;
             double CYP = domain.cell[i][j][k].cyp*theta;
             double CYM = domain.cell[i][j][k].cym*theta;
-            double Q = domain.cell[i][j][k].heatGain*theta;
 
             if (foundation.numberOfDimensions == 3)
             {
-              A = (1.0 + f*(CXP + CZP + CYP - CXM - CZM - CYM));
-              Aim = f*CXM;
-              Aip = f*(-CXP);
-              Akm = f*CZM;
-              Akp = f*(-CZP);
-              Ajm = f*CYM;
-              Ajp = f*(-CYP);
+              if (!matrixInteriorCurrent)
+              {
+                A = (1.0 + f*(CXP + CZP + CYP - CXM - CZM - CYM));
+                Aim = f*CXM;
+                Aip = f*(-CXP);
+                Akm = f*CZM;
+                Akp = f*(-CZP);
+                Ajm = f*CYM;
+                Ajp = f*(-CYP);
+
+                setAmatValue(index,index,A);
+                setAmatValue(index,index_ip,Aip);
+                setAmatValue(index,index_im,Aim);
+                setAmatValue(index,index_jp,Ajp);
+                setAmatValue(index,index_jm,Ajm);
+                setAmatValue(index,index_kp,Akp);
+                setAmatValue(index,index_km,Akm);
+              }
 
               bVal = TOld[i][j][k]*(1.0 + (1-f)*(CXM + CZM + CYM - CXP - CZP - CYP))
                  - TOld[i-1][j][k]*(1-f)*CXM
@@ -1116,15 +1388,8 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
                  + TOld[i][j+1][k]*(1-f)*CYP
                  + Q;
 
-              setAmatValue(index,index,A);
-              setAmatValue(index,index_ip,Aip);
-              setAmatValue(index,index_im,Aim);
-              setAmatValue(index,index_jp,Ajp);
-              setAmatValue(index,index_jm,Ajm);
-              setAmatValue(index,index_kp,Akp);
-              setAmatValue(index,index_km,Akm);
               setbValue(index,bVal);
-}
+            }
             else
             {
               double CXPC = 0;
@@ -1136,11 +1401,21 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
                 CXPC = domain.cell[i][j][k].cxp_c*theta/r;
                 CXMC = domain.cell[i][j][k].cxm_c*theta/r;
               }
-              A = (1.0 + f*(CXPC + CXP + CZP - CXMC - CXM - CZM));
-              Aim = f*(CXMC + CXM);
-              Aip = f*(-CXPC - CXP);
-              Akm = f*CZM;
-              Akp = f*(-CZP);
+
+              if (!matrixInteriorCurrent)
+              {
+                A = (1.0 + f*(CXPC + CXP + CZP - CXMC - CXM - CZM));
+                Aim = f*(CXMC + CXM);
+                Aip = f*(-CXPC - CXP);
+                Akm = f*CZM;
+                Akp = f*(-CZP);
+
+                setAmatValue(index,index,A);
+                setAmatValue(index,index_ip,Aip);
+                setAmatValue(index,index_im,Aim);
+                setAmatValue(index,index_kp,Akp);
+                setAmatValue(index,index_km,Akm);
+              }
 
               bVal = TOld[i][j][k]*(1.0 + (1-f)*(CXMC + CXM + CZM - CXPC - CXP - CZP))
                  - TOld[i-1][j][k]*(1-f)*(CXMC + CXM)
@@ -1149,11 +1424,6 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
                  + TOld[i][j][k+1]*(1-f)*CZP
                  + Q;
 
-              setAmatValue(index,index,A);
-              setAmatValue(index,index_ip,Aip);
-              setAmatValue(index,index_im,Aim);
-              setAmatValue(index,index_kp,Akp);
-              setAmatValue(index,index_km,Akm);
               setbValue(index,bVal);
             }
           }
@@ -1164,6 +1434,24 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
     }
   }
 
+  if (buildingMatrix)
+  {
+    csrPtr.assign(1, 0);
+    for (std::size_t row = 0; row < matrixRows.size(); row++)
+    {
+      for (std::size_t e = 0; e < matrixRows[row].size(); e++)
+      {
+        csrIndex.push_back(matrixRows[row][e].first);
+        csrValue.push_back(matrixRows[row][e].second);
+      }
+      csrPtr.push_back(LIS_INT(csrIndex.size()));
+    }
+    std::vector<std::vector<std::pair<LIS_INT,double>>>().swap(matrixRows);
+  }
+  matrixInteriorCurrent = true;
+  matrixScheme = scheme;
+  matrixTimestep = timestep;
+
   solveLinearSystem();
 
   for (size_t i = 0; i < nX; ++i)
@@ -1187,6 +1475,9 @@ void Ground::calculateMatrix(Foundation::NumericalScheme scheme)
 
 void Ground::calculateADI(int dim)
 {
+  Tracer::Scope trace("ADI sweep");
+  calculateBoundaryCoefficients();
+
   for (size_t i = 0; i < nX; i++)
   {
     for (size_t j = 0; j < nY; j++)
@@ -1209,19 +1500,20 @@ void Ground::calculateADI(int dim)
         {
         case Cell::BOUNDARY:
           {
+          Surface &surface = foundation.surfaces[domain.cell[i][j][k].surfaceNumber];
           double tilt;
-          if (domain.cell[i][j][k].surface.orientation == Surface::Z_POS)
+          if (surface.orientation == Surface::Z_POS)
             tilt = 0;
-          else if (domain.cell[i][j][k].surface.orientation == Surface::Z_NEG)
+          else if (surface.orientation == Surface::Z_NEG)
             tilt = PI;
           else
             tilt = PI/2.0;
 
-          switch (domain.cell[i][j][k].surface.boundaryConditionType)
+          switch (surface.boundaryConditionType)
           {
           case Surface::ZERO_FLUX:
             {
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               A = 1.0;
@@ -1331,7 +1623,7 @@ void Ground::calculateADI(int dim)
             break;
           case Surface::CONSTANT_TEMPERATURE:
             A = 1.0;
-            bVal = domain.cell[i][j][k].surface.temperature;
+            bVal = surface.temperature;
 
             setAmatValue(index,index,A);
             setbValue(index,bVal);
@@ -1355,12 +1647,10 @@ void Ground::calculateADI(int dim)
             double Tair = bcs.indoorTemp;
             double q = 0;
 
-            double hc = getConvectionCoeff(TOld[i][j][k],
-                    Tair,0.0,1.52,false,tilt);
-            double hr = getSimpleInteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,
-                               TOld[i][j][k],Tair);
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               A = domain.getKXP(i,j,k)/domain.getDXP(i) + (hc + hr);
@@ -1471,14 +1761,13 @@ void Ground::calculateADI(int dim)
           case Surface::EXTERIOR_FLUX:
             {
             double Tair = bcs.outdoorTemp;
-            double v = bcs.localWindSpeed;
             double eSky = bcs.skyEmissivity;
             double F = getEffectiveExteriorViewFactor(eSky,tilt);
-            double hc = getConvectionCoeff(TOld[i][j][k],Tair,v,foundation.surfaceRoughness,true,tilt);
-            double hr = getExteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,TOld[i][j][k],Tair,eSky,tilt);
-            double q = domain.cell[i][j][k].surface.absorptivity*bcs.globalHorizontalFlux;
+            double hc = boundaryHc[domain.cell[i][j][k].boundaryIndex];
+            double hr = boundaryHr[domain.cell[i][j][k].boundaryIndex];
+            double q = surface.absorptivity*bcs.globalHorizontalFlux;
 
-            switch (domain.cell[i][j][k].surface.orientation)
+            switch (surface.orientation)
             {
             case Surface::X_NEG:
               A = domain.getKXP(i,j,k)/domain.getDXP(i) + (hc + hr);
@@ -1744,12 +2033,26 @@ void Ground::calculateADI(int dim)
 
 void Ground::calculate(BoundaryConditions& boundaryConidtions, double ts)
 {
+  Tracer::Scope trace("Ground::calculate");
   bcs = boundaryConidtions;
   timestep = ts;
+
+  // Only the explicit scheme is calculated on a distributed domain (see
+  // distribute)
+  assert(!distributed || foundation.numericalScheme == Foundation::NS_EXPLICIT);
+
   // update boundary conditions
-  setSolarBoundaryConditions();
+  {
+    PhaseTimer::Scope scope(timer, PhaseTimer::PH_BOUNDARY_CONDITIONS);
+    Tracer::Scope trace("Boundary conditions");
+    setSolarBoundaryConditions();
+  }
 
   // Calculate Temperatures
+  PhaseTimer::Scope scope(timer, PhaseTimer::PH_SOLVE);
+  if (timer)
+    timer->addCellUpdates((iEnd - iBegin)*nY*nZ);
+
   switch(foundation.numericalScheme)
   {
   case Foundation::NS_ADE:
@@ -1777,6 +2080,93 @@ void Ground::calculate(BoundaryConditions& boundaryConidtions, double ts)
 
 }
 
+void Ground::setEnsembleSize(std::size_t members)
+{
+  for (std::size_t m = 0; m < ensembleX.size(); m++)
+    lis_vector_destroy(ensembleX[m]);
+
+  ensembleTNew.assign(members, TOld);
+  ensembleTOld.assign(members, TOld);
+  ensembleOutputValues.assign(members, groundOutput.outputValues);
+
+  // Each member keeps its own solution vector so the iterative solvers start
+  // from the member's previous solution (none when distributed)
+  ensembleX.resize(members);
+  for (std::size_t m = 0; m < members; m++)
+  {
+    ensembleX[m] = NULL;
+    if (distributed)
+      continue;
+    lis_vector_duplicate(x,&ensembleX[m]);
+    lis_vector_copy(x,ensembleX[m]);
+  }
+}
+
+std::size_t Ground::getEnsembleSize()
+{
+  return ensembleTOld.size();
+}
+
+std::vector<double> Ground::getSolverGuess(long member)
+{
+  if (distributed)
+    return std::vector<double>();
+
+  LIS_VECTOR &guess = member < 0 ? x : ensembleX[member];
+
+  std::vector<double> values(nX*nY*nZ);
+  for (std::size_t i = 0; i < values.size(); i++)
+    lis_vector_get_value(guess,LIS_INT(i),&values[i]);
+  return values;
+}
+
+void Ground::setSolverGuess(const std::vector<double> &values, long member)
+{
+  if (distributed)
+    return;
+
+  LIS_VECTOR &guess = member < 0 ? x : ensembleX[member];
+
+  for (std::size_t i = 0; i < values.size(); i++)
+    lis_vector_set_value(LIS_INS_VALUE,LIS_INT(i),values[i],guess);
+}
+
+void Ground::calculateEnsemble(std::vector<BoundaryConditions>& boundaryConditions, double ts)
+{
+  // One set of boundary conditions per member, plus the main solution
+  assert(boundaryConditions.size() == ensembleTOld.size() + 1);
+
+  // Swap each member's state in, advance it, and swap it back out. The main
+  // solution is calculated last so that the boundary conditions (and surface
+  // averages) of the main solution remain current.
+  for (std::size_t m = 0; m < ensembleTOld.size(); m++)
+  {
+    std::swap(TOld, ensembleTOld[m]);
+    std::swap(TNew, ensembleTNew[m]);
+    std::swap(x, ensembleX[m]);
+
+    calculate(boundaryConditions[m], ts);
+    calculateSurfaceAverages();
+    ensembleOutputValues[m] = groundOutput.outputValues;
+
+    std::swap(TOld, ensembleTOld[m]);
+    std::swap(TNew, ensembleTNew[m]);
+    std::swap(x, ensembleX[m]);
+  }
+
+  calculate(boundaryConditions.back(), ts);
+}
+
+double Ground::getEnsembleSurfaceAverageValue(std::size_t member, std::pair<Surface::SurfaceType, GroundOutput::OutputType> output)
+{
+  return ensembleOutputValues[member][groundOutput.getOutputIndex(output.first, output.second)];
+}
+
+double Ground::getEnsembleSurfaceAverageValue(std::size_t member, std::size_t outputIndex)
+{
+  return ensembleOutputValues[member][outputIndex];
+}
+
 void Ground::setAmatValue(const int i,const int j,const double val)
 {
   if (foundation.numericalScheme == Foundation::NS_ADI && TDMA)
@@ -1788,10 +2178,38 @@ void Ground::setAmatValue(const int i,const int j,const double val)
     else
       a3[i] = val;
   }
-  else
+  else if (foundation.numericalScheme == Foundation::NS_ADI)
   {
     lis_matrix_set_value(LIS_INS_VALUE,i,j,val,Amat);
   }
+  else if (csrPtr.empty())
+  {
+    // Building the structure (entries are kept in the order they are set)
+    std::vector<std::pair<LIS_INT,double>> &row = matrixRows[i];
+    for (std::size_t e = 0; e < row.size(); e++)
+    {
+      if (row[e].first == j)
+      {
+        row[e].second = val;
+        return;
+      }
+    }
+    row.push_back(std::make_pair(LIS_INT(j), val));
+  }
+  else
+  {
+    for (LIS_INT e = csrPtr[i]; e < csrPtr[i+1]; e++)
+    {
+      if (csrIndex[e] == j)
+      {
+        csrValue[e] = val;
+        return;
+      }
+    }
+    // Every scheme sets the same entries each timestep, so the structure
+    // built on the first solution must already contain (i,j)
+    assert(false && "Matrix entry is not in the assembled structure");
+  }
 }
 
 void Ground::setbValue(const int i,const double val)
@@ -1810,14 +2228,32 @@ void Ground::solveLinearSystem()
 {
   if (foundation.numericalScheme == Foundation::NS_ADI && TDMA)
   {
+    Tracer::Scope trace("TDMA solve");
     solveTDM(a1,a2,a3,b_,x_);
   }
   else
   {
-    lis_matrix_set_type(Amat,LIS_MATRIX_CSR);
+    if (foundation.numericalScheme == Foundation::NS_ADI)
+    {
+      lis_matrix_set_type(Amat,LIS_MATRIX_CSR);
+    }
+    else
+    {
+      LIS_INT nnz = LIS_INT(csrValue.size());
+      LIS_INT *ptr, *index;
+      LIS_SCALAR *value;
+      lis_matrix_malloc_csr(LIS_INT(nX*nY*nZ),nnz,&ptr,&index,&value);
+      std::copy(csrPtr.begin(), csrPtr.end(), ptr);
+      std::copy(csrIndex.begin(), csrIndex.end(), index);
+      std::copy(csrValue.begin(), csrValue.end(), value);
+      lis_matrix_set_csr(nnz,ptr,index,value,Amat);
+    }
     lis_matrix_assemble(Amat);
 
-    lis_solve(Amat,b,x,solver);
+    {
+      Tracer::Scope trace("LIS solve");
+      lis_solve(Amat,b,x,solver);
+    }
 
     int status;
     lis_solver_get_status(solver, &status);
@@ -1881,24 +2317,6 @@ double Ground::getxValue(const int i)
 }
 
 
-double Ground::getConvectionCoeff(double Tsurf,
-                  double Tamb,
-                  double Vair,
-                    double roughness,
-                  bool isExterior,
-                  double tilt)
-{
-  if (foundation.convectionCalculationMethod == Foundation::CCM_AUTO)
-    return getDOE2ConvectionCoeff(tilt,0.0,0.0,Tsurf,Tamb,Vair,roughness);
-  else //if (foundation.convectionCalculationMethod == Foundation::CCM_CONSTANT_COEFFICIENT)
-  {
-    if (isExterior)
-      return foundation.exteriorConvectiveCoefficient;
-    else
-      return foundation.interiorConvectiveCoefficient;
-  }
-}
-
 double Ground::getSurfaceArea(Surface::SurfaceType surfaceType)
 {
   double totalArea = 0;
@@ -1918,30 +2336,28 @@ double Ground::getSurfaceArea(Surface::SurfaceType surfaceType)
   return totalArea;
 }
 
-void Ground::calculateSurfaceAverages(){
+void Ground::compileSurfaceAverages()
+{
+  surfaceAveragePlans.clear();
+
   for (auto output : groundOutput.outputMap) {
     Surface::SurfaceType surface = output.first;
-    std::vector<GroundOutput::OutputType> outTypes = output.second;
 
-    double constructionRValue = 0.0;
-    double surfaceArea = foundation.surfaceAreas[surface];
+    SurfaceAveragePlan plan;
+
+    plan.constructionRValue = 0.0;
+    plan.surfaceArea = foundation.surfaceAreas[surface];
 
     if (surface == Surface::ST_SLAB_CORE) {
-      constructionRValue = foundation.slab.totalResistance();
+      plan.constructionRValue = foundation.slab.totalResistance();
     }
     else if (surface == Surface::ST_SLAB_PERIM) {
-      constructionRValue = foundation.slab.totalResistance();
+      plan.constructionRValue = foundation.slab.totalResistance();
     }
     else if (surface == Surface::ST_WALL_INT) {
-      constructionRValue = foundation.wall.totalResistance();
+      plan.constructionRValue = foundation.wall.totalResistance();
     }
 
-    double totalHeatTransferRate = 0;
-    double TA = 0;
-    double totalArea = 0;
-
-    double& Tair = bcs.indoorTemp;
-
     if (foundation.hasSurface[surface]) {
       // Find surface(s)
       for (size_t s = 0; s < foundation.surfaces.size(); s++)
@@ -1957,50 +2373,231 @@ void Ground::calculateSurfaceAverages(){
           else
             tilt = PI/2.0;
 
-
           for (std::size_t index = 0; index < foundation.surfaces[s].indices.size(); index++)
           {
             std::size_t i = boost::get<0>(foundation.surfaces[s].indices[index]);
             std::size_t j = boost::get<1>(foundation.surfaces[s].indices[index]);
             std::size_t k = boost::get<2>(foundation.surfaces[s].indices[index]);
 
-            double h = getConvectionCoeff(TNew[i][j][k],Tair,0.0,1.52,false,tilt)
-                 + getSimpleInteriorIRCoeff(domain.cell[i][j][k].surface.emissivity,
-                     TNew[i][j][k],Tair);
-
-            double& A = domain.cell[i][j][k].area;
-
-            totalArea += A;
-            totalHeatTransferRate += h*A*(Tair - TNew[i][j][k]);
-            TA += TNew[i][j][k]*A;
+            // Cells outside of the local slab are summed by other processes
+            if (i < iBegin || i >= iEnd)
+              continue;
 
+            plan.i.push_back(i);
+            plan.j.push_back(j);
+            plan.k.push_back(k);
+            plan.area.push_back(domain.cell[i][j][k].area);
+            plan.emissivity.push_back(foundation.surfaces[s].emissivity);
+            plan.tilt.push_back(tilt);
           }
         }
       }
     }
 
+    plan.T.resize(plan.area.size());
+    plan.hc.resize(plan.area.size());
+    plan.hr.resize(plan.area.size());
+
+    surfaceAveragePlans.push_back(plan);
+  }
+}
+
+void Ground::compileBoundaryCells()
+{
+  boundaryI.clear();
+  boundaryJ.clear();
+  boundaryK.clear();
+  boundaryTilt.clear();
+  boundaryEmissivity.clear();
+
+  // Interior flux cells first, then exterior flux cells
+  for (int pass = 0; pass < 2; pass++)
+  {
+    Surface::BoundaryConditionType bcType =
+        pass == 0 ? Surface::INTERIOR_FLUX : Surface::EXTERIOR_FLUX;
+
+    for (size_t s = 0; s < foundation.surfaces.size(); s++)
+    {
+      if (foundation.surfaces[s].boundaryConditionType != bcType)
+        continue;
+
+      double tilt;
+      if (foundation.surfaces[s].orientation == Surface::Z_POS)
+        tilt = 0;
+      else if (foundation.surfaces[s].orientation == Surface::Z_NEG)
+        tilt = PI;
+      else
+        tilt = PI/2.0;
+
+      for (std::size_t index = 0; index < foundation.surfaces[s].indices.size(); index++)
+      {
+        std::size_t i = boost::get<0>(foundation.surfaces[s].indices[index]);
+        std::size_t j = boost::get<1>(foundation.surfaces[s].indices[index]);
+        std::size_t k = boost::get<2>(foundation.surfaces[s].indices[index]);
+
+        // Cells outside of the local slab are calculated by other processes
+        if (i < iBegin || i >= iEnd)
+          continue;
+
+        // A cell on more than one surface takes its boundary condition from
+        // the surface it references, so it is listed once, for that surface
+        if (domain.cell[i][j][k].surfaceNumber != int(s))
+          continue;
+
+        domain.cell[i][j][k].boundaryIndex = boundaryI.size();
+
+        boundaryI.push_back(i);
+        boundaryJ.push_back(j);
+        boundaryK.push_back(k);
+        boundaryTilt.push_back(tilt);
+        boundaryEmissivity.push_back(foundation.surfaces[s].emissivity);
+      }
+    }
+
+    if (pass == 0)
+      nInteriorBoundaryCells = boundaryI.size();
+  }
+
+  boundaryT.resize(boundaryI.size());
+  boundaryHc.resize(boundaryI.size());
+  boundaryHr.resize(boundaryI.size());
+}
+
+void Ground::calculateBoundaryCoefficients()
+{
+  Tracer::Scope trace("Boundary coefficients");
+  std::size_t nCells = boundaryI.size();
+  if (nCells == 0)
+    return;
+
+  for (std::size_t c = 0; c < nCells; c++)
+    boundaryT[c] = TOld[boundaryI[c]][boundaryJ[c]][boundaryK[c]];
+
+  std::size_t nInt = nInteriorBoundaryCells;
+  std::size_t nExt = nCells - nInt;
+
+  if (foundation.convectionCalculationMethod == Foundation::CCM_AUTO)
+  {
+    getDOE2ConvectionCoeffs(nInt, &boundaryTilt[0], &boundaryT[0],
+        bcs.indoorTemp, 0.0, 1.52, &boundaryHc[0]);
+    getDOE2ConvectionCoeffs(nExt, &boundaryTilt[nInt], &boundaryT[nInt],
+        bcs.outdoorTemp, bcs.localWindSpeed, foundation.surfaceRoughness,
+        &boundaryHc[nInt]);
+  }
+  else //if (foundation.convectionCalculationMethod == Foundation::CCM_CONSTANT_COEFFICIENT)
+  {
+    std::fill(boundaryHc.begin(), boundaryHc.begin() + nInt,
+        foundation.interiorConvectiveCoefficient);
+    std::fill(boundaryHc.begin() + nInt, boundaryHc.end(),
+        foundation.exteriorConvectiveCoefficient);
+  }
+
+  getSimpleInteriorIRCoeffs(nInt, &boundaryEmissivity[0], &boundaryT[0],
+      bcs.indoorTemp, &boundaryHr[0]);
+  getExteriorIRCoeffs(nExt, &boundaryEmissivity[nInt], &boundaryT[nInt],
+      bcs.outdoorTemp, bcs.skyEmissivity, &boundaryTilt[nInt], &boundaryHr[nInt]);
+}
+
+void Ground::calculateSurfaceAverages(){
+  PhaseTimer::Scope scope(timer, PhaseTimer::PH_SURFACE_AVERAGES);
+  Tracer::Scope trace("Surface averages");
+  std::size_t nPlans = surfaceAveragePlans.size();
+
+  // Sums of area, heat transfer rate and area-weighted temperature
+  std::vector<double> sums(3*nPlans, 0.0);
+
+  double& Tair = bcs.indoorTemp;
+
+  for (std::size_t p = 0; p < nPlans; p++) {
+    SurfaceAveragePlan &plan = surfaceAveragePlans[p];
+
+    double totalHeatTransferRate = 0;
+    double TA = 0;
+    double totalArea = 0;
+
+    std::size_t nCells = plan.area.size();
+
+    if (nCells > 0)
+    {
+      for (std::size_t n = 0; n < nCells; n++)
+        plan.T[n] = TNew[plan.i[n]][plan.j[n]][plan.k[n]];
+
+      if (foundation.convectionCalculationMethod == Foundation::CCM_AUTO)
+        getDOE2ConvectionCoeffs(nCells, &plan.tilt[0], &plan.T[0], Tair, 0.0, 1.52, &plan.hc[0]);
+      else //if (foundation.convectionCalculationMethod == Foundation::CCM_CONSTANT_COEFFICIENT)
+        std::fill(plan.hc.begin(), plan.hc.end(), foundation.interiorConvectiveCoefficient);
+
+      getSimpleInteriorIRCoeffs(nCells, &plan.emissivity[0], &plan.T[0], Tair, &plan.hr[0]);
+    }
+
+    for (std::size_t n = 0; n < nCells; n++)
+    {
+      double h = plan.hc[n] + plan.hr[n];
+
+      double A = plan.area[n];
+
+      totalArea += A;
+      totalHeatTransferRate += h*A*(Tair - plan.T[n]);
+      TA += plan.T[n]*A;
+    }
+
+    sums[3*p] = totalArea;
+    sums[3*p + 1] = totalHeatTransferRate;
+    sums[3*p + 2] = TA;
+  }
+
+#ifdef ENABLE_MPI
+  if (distributed && nPlans > 0)
+  {
+    std::vector<double> globalSums(3*nPlans);
+    MPI_Allreduce(&sums[0], &globalSums[0], 3*nPlans, MPI_DOUBLE, MPI_SUM, comm);
+    sums = globalSums;
+  }
+#endif
+
+  for (std::size_t p = 0; p < nPlans; p++) {
+    const SurfaceAveragePlan &plan = surfaceAveragePlans[p];
+
+    double totalArea = sums[3*p];
+    double totalHeatTransferRate = sums[3*p + 1];
+    double TA = sums[3*p + 2];
+
+    double *values = &groundOutput.outputValues[p*GroundOutput::numberOfOutputTypes];
+
     double Tavg = TA/totalArea;
-    groundOutput.outputValues[{surface,GroundOutput::OT_TEMP}] = Tavg;
-    groundOutput.outputValues[{surface,GroundOutput::OT_FLUX}] = totalHeatTransferRate/totalArea;
-    groundOutput.outputValues[{surface,GroundOutput::OT_RATE}] = totalHeatTransferRate/totalArea*surfaceArea;
+    values[GroundOutput::OT_TEMP] = Tavg;
+    values[GroundOutput::OT_FLUX] = totalHeatTransferRate/totalArea;
+    values[GroundOutput::OT_RATE] = totalHeatTransferRate/totalArea*plan.surfaceArea;
 
     double hAvg = totalHeatTransferRate/(totalArea*(Tair - Tavg));
 
-    groundOutput.outputValues[{surface,GroundOutput::OT_EFF_TEMP}] = Tair - (totalHeatTransferRate/totalArea)*(constructionRValue+1/hAvg) - 273.15;
+    values[GroundOutput::OT_EFF_TEMP] = Tair - (totalHeatTransferRate/totalArea)*(plan.constructionRValue+1/hAvg) - 273.15;
   }
 }
 
 double Ground::getSurfaceAverageValue(std::pair<Surface::SurfaceType, GroundOutput::OutputType> output)
 {
-  return groundOutput.outputValues[output];
+  return groundOutput.outputValues[groundOutput.getOutputIndex(output.first, output.second)];
+}
+
+double Ground::getSurfaceAverageValue(std::size_t outputIndex)
+{
+  return groundOutput.outputValues[outputIndex];
 }
 
 std::vector<double> Ground::calculateHeatFlux(const size_t &i, const size_t &j, const size_t &k)
 {
-  std::vector<double> Qflux;
-  double Qx = 0;
-  double Qy = 0;
-  double Qz = 0;
+  std::vector<double> Qflux(3);
+  calculateHeatFlux(i, j, k, Qflux[0], Qflux[1], Qflux[2]);
+  return Qflux;
+}
+
+void Ground::calculateHeatFlux(std::size_t i, std::size_t j, std::size_t k,
+                               double &Qx, double &Qy, double &Qz)
+{
+  Qx = 0;
+  Qy = 0;
+  Qz = 0;
 
   double CXP = -domain.getKXP(i,j,k)*domain.getDXM(i)/(domain.getDXP(i)+domain.getDXM(i))/domain.getDXP(i);
   double CXM = -domain.getKXM(i,j,k)*domain.getDXP(i)/(domain.getDXP(i)+domain.getDXM(i))/domain.getDXM(i);
@@ -2044,7 +2641,8 @@ std::vector<double> Ground::calculateHeatFlux(const size_t &i, const size_t &j,
   {
     case Cell::BOUNDARY:
       {
-        switch (domain.cell[i][j][k].surface.orientation)
+        Surface &surface = foundation.surfaces[domain.cell[i][j][k].surfaceNumber];
+        switch (surface.orientation)
         {
           case Surface::X_NEG:
             {
@@ -2096,23 +2694,23 @@ std::vector<double> Ground::calculateHeatFlux(const size_t &i, const size_t &j,
       {
         int numZeroDims = domain.getNumZeroDims(i,j,k);
 
-        std::vector<double> Qm;
-        std::vector<double> Qp;
+        double Qm[3];
+        double Qp[3];
 
         if (isEqual(domain.meshX.deltas[i], 0.0))
         {
-          Qm = calculateHeatFlux(i-1,j,k);
-          Qp = calculateHeatFlux(i+1,j,k);
+          calculateHeatFlux(i-1,j,k,Qm[0],Qm[1],Qm[2]);
+          calculateHeatFlux(i+1,j,k,Qp[0],Qp[1],Qp[2]);
         }
         if (isEqual(domain.meshY.deltas[j], 0.0))
         {
-          Qm = calculateHeatFlux(i,j-1,k);
-          Qp = calculateHeatFlux(i,j+1,k);
+          calculateHeatFlux(i,j-1,k,Qm[0],Qm[1],Qm[2]);
+          calculateHeatFlux(i,j+1,k,Qp[0],Qp[1],Qp[2]);
         }
         if (isEqual(domain.meshZ.deltas[k], 0.0))
         {
-          Qm = calculateHeatFlux(i,j,k-1);
-          Qp = calculateHeatFlux(i,j,k+1);
+          calculateHeatFlux(i,j,k-1,Qm[0],Qm[1],Qm[2]);
+          calculateHeatFlux(i,j,k+1,Qp[0],Qp[1],Qp[2]);
         }
 
         Qx = (Qm[0] + Qp[0])*0.5;
@@ -2128,16 +2726,122 @@ std::vector<double> Ground::calculateHeatFlux(const size_t &i, const size_t &j,
       }
     break;
   }
+}
+
+void Ground::calculateHeatFlux(std::size_t iMin, std::size_t iMax,
+                               std::size_t jMin, std::size_t jMax,
+                               std::size_t kMin, std::size_t kMax,
+                               double *Qx, double *Qy, double *Qz, double *Qmag)
+{
+#ifdef ENABLE_MPI
+  if (distributed)
+  {
+    // Each process calculates the columns of the block it owns, for the
+    // components requested by the root process
+    double *Q[4] = {Qx, Qy, Qz, Qmag};
+    int requested[4];
+    for (int q = 0; q < 4; q++)
+      requested[q] = Q[q] != NULL;
+    MPI_Bcast(requested, 4, MPI_INT, 0, comm);
+
+    std::size_t iLo = std::max(iMin, iBegin);
+    std::size_t iHi = std::min(iMax + 1, iEnd);
+    std::size_t nJK = (jMax - jMin + 1)*(kMax - kMin + 1);
+    std::size_t nLocal = iHi > iLo ? (iHi - iLo)*nJK : 0;
+
+    std::vector<std::vector<double>> local(4);
+    for (int q = 0; q < 4; q++)
+      if (requested[q])
+        local[q].resize(nLocal);
+
+    if (nLocal > 0)
+      calculateLocalHeatFlux(iLo, iHi - 1, jMin, jMax, kMin, kMax,
+          requested[0] ? &local[0][0] : NULL, requested[1] ? &local[1][0] : NULL,
+          requested[2] ? &local[2][0] : NULL, requested[3] ? &local[3][0] : NULL);
+
+    for (int q = 0; q < 4; q++)
+      if (requested[q])
+        gatherBlock(iMin, iMax, nJK, local[q], Q[q]);
+    return;
+  }
+#endif
 
-  Qflux.push_back(Qx);
-  Qflux.push_back(Qy);
-  Qflux.push_back(Qz);
+  calculateLocalHeatFlux(iMin, iMax, jMin, jMax, kMin, kMax, Qx, Qy, Qz, Qmag);
+}
 
-  return Qflux;
+void Ground::calculateLocalHeatFlux(std::size_t iMin, std::size_t iMax,
+                                    std::size_t jMin, std::size_t jMax,
+                                    std::size_t kMin, std::size_t kMax,
+                                    double *Qx, double *Qy, double *Qz, double *Qmag)
+{
+  std::size_t nI = iMax - iMin + 1;
+  std::size_t nJ = jMax - jMin + 1;
+  long nK = kMax - kMin + 1;
+
+  #pragma omp parallel for
+  for (long kk = 0; kk < nK; kk++)
+  {
+    std::size_t k = kMin + kk;
+    for (std::size_t j = jMin; j <= jMax; j++)
+    {
+      std::size_t index = nI*(j-jMin) + nI*nJ*kk;
+      for (std::size_t i = iMin; i <= iMax; i++, index++)
+      {
+        double qx, qy, qz;
+        calculateHeatFlux(i, j, k, qx, qy, qz);
+
+        if (Qx)
+          Qx[index] = qx;
+        if (Qy)
+          Qy[index] = qy;
+        if (Qz)
+          Qz[index] = qz;
+        if (Qmag)
+          Qmag[index] = sqrt(qx*qx + qy*qy + qz*qz);
+      }
+    }
+  }
+}
+
+void Ground::getTemperatures(std::size_t iMin, std::size_t iMax,
+                             std::size_t jMin, std::size_t jMax,
+                             std::size_t kMin, std::size_t kMax,
+                             double *T)
+{
+  // Columns of the block owned by this process
+  std::size_t iLo = std::max(iMin, iBegin);
+  std::size_t iHi = std::min(iMax + 1, iEnd);
+  std::size_t nI = iHi > iLo ? iHi - iLo : 0;
+  std::size_t nJ = jMax - jMin + 1;
+  std::size_t nK = kMax - kMin + 1;
+
+  // When distributed, the owned columns are gathered from a local block
+  std::vector<double> local(distributed ? nI*nJ*nK : 0);
+  double *values = T;
+  if (distributed)
+    values = local.empty() ? NULL : &local[0];
+
+  for (std::size_t k = kMin; k <= kMax; k++)
+  {
+    for (std::size_t j = jMin; j <= jMax; j++)
+    {
+      std::size_t index = nI*(j-jMin) + nI*nJ*(k-kMin);
+      for (std::size_t i = iLo; i < iHi; i++, index++)
+        values[index] = TNew[i][j][k];
+    }
+  }
+
+#ifdef ENABLE_MPI
+  if (distributed)
+    gatherBlock(iMin, iMax, nJ*nK, local, T);
+#endif
 }
 
 void Ground::calculateBoundaryLayer()
 {
+  PhaseTimer::Scope scope(timer, PhaseTimer::PH_BOUNDARY_LAYER);
+  Tracer::Scope trace("Boundary layer");
+
   Foundation fd = foundation;
 
   BoundaryConditions preBCs;
@@ -2149,6 +2853,7 @@ void Ground::calculateBoundaryLayer()
   fd.reductionStrategy = Foundation::RS_AP;
   fd.numericalScheme = Foundation::NS_STEADY_STATE;
   fd.farFieldWidth = 100;
+  fd.exteriorShading = false;
 
   Ground pre(fd);
   pre.buildDomain();
@@ -2170,9 +2875,16 @@ void Ground::calculateBoundaryLayer()
 
   size_t j = pre.nY/2;
 
+  std::vector<double> Qzs;
+  if (i_min < pre.nX)
+  {
+    Qzs.resize(pre.nX - i_min);
+    pre.calculateHeatFlux(i_min, pre.nX - 1, j, j, k, k, NULL, NULL, &Qzs[0], NULL);
+  }
+
   for (size_t i = i_min; i < pre.nX; i++)
   {
-    double Qz = pre.calculateHeatFlux(i,j,k)[2];
+    double Qz = Qzs[i - i_min];
     double x = pre.domain.meshX.centers[i];
     double x1 = pre.domain.meshX.dividers[i];
     double x2 = pre.domain.meshX.dividers[i+1];
@@ -2208,47 +2920,44 @@ void Ground::calculateBoundaryLayer()
 
 double Ground::getBoundaryValue(double dist)
 {
-  double val;
-  if (dist > boundaryLayer[boundaryLayer.size()-1].first)
-    val = 1.0;
-  else
-  {
-    for (std::size_t i = 0; i < boundaryLayer.size()-1; i++)
-    {
-      if (dist >= boundaryLayer[i].first && dist < boundaryLayer[i+1].first)
-      {
-        double m = (boundaryLayer[i+1].first - boundaryLayer[i].first)/
-            (boundaryLayer[i+1].second - boundaryLayer[i].second);
-        val = (dist - boundaryLayer[i].first)/m + boundaryLayer[i].second;
-        continue;
-      }
-    }
-  }
-  return val;
+  // Boundary layer distances are sorted, so the interval containing dist is
+  // found by bisection
+  if (dist >= boundaryLayer[boundaryLayer.size()-1].first)
+    return 1.0;
+
+  std::vector<std::pair<double,double>>::const_iterator upper =
+      std::upper_bound(boundaryLayer.begin(), boundaryLayer.end(), dist,
+                       [](double d, const std::pair<double,double> &point) {return d < point.first;});
+  if (upper == boundaryLayer.begin())
+    return 0.0;
+
+  std::size_t i = upper - boundaryLayer.begin() - 1;
+  double m = (boundaryLayer[i+1].first - boundaryLayer[i].first)/
+      (boundaryLayer[i+1].second - boundaryLayer[i].second);
+  return (dist - boundaryLayer[i].first)/m + boundaryLayer[i].second;
 }
 
 double Ground::getBoundaryDistance(double val)
 {
-  double dist;
   if (val > 1.0 || val < 0.0)
   {
     std::cerr << "ERROR: Boundary value passed not between 0.0 and 1.0." << std::endl;
     exit (EXIT_FAILURE);
   }
-  else
-  {
-    for (std::size_t i = 0; i < boundaryLayer.size()-1; i++)
-    {
-      if (val >= boundaryLayer[i].second && val < boundaryLayer[i+1].second)
-      {
-        double m = (boundaryLayer[i+1].second - boundaryLayer[i].second)/
-            (boundaryLayer[i+1].first - boundaryLayer[i].first);
-        dist = (val - boundaryLayer[i].second)/m + boundaryLayer[i].first;
-        continue;
-      }
-    }
-  }
-  return dist;
+
+  // Boundary layer values are sorted, so the interval containing val is
+  // found by bisection
+  if (val >= boundaryLayer[boundaryLayer.size()-1].second)
+    return boundaryLayer[boundaryLayer.size()-1].first;
+
+  std::vector<std::pair<double,double>>::const_iterator upper =
+      std::upper_bound(boundaryLayer.begin(), boundaryLayer.end(), val,
+                       [](double v, const std::pair<double,double> &point) {return v < point.second;});
+
+  std::size_t i = upper - boundaryLayer.begin() - 1;
+  double m = (boundaryLayer[i+1].second - boundaryLayer[i].second)/
+      (boundaryLayer[i+1].first - boundaryLayer[i].first);
+  return (val - boundaryLayer[i].second)/m + boundaryLayer[i].first;
 }
 
 void Ground::setNewBoundaryGeometry()
@@ -2328,8 +3037,133 @@ void Ground::setNewBoundaryGeometry()
 
 }
 
+void Ground::compileShading()
+{
+  solarI.clear();
+  solarJ.clear();
+  solarK.clear();
+  solarOrientation.clear();
+  sunlitFractions.clear();
+
+  // Exterior shading requires a three-dimensional domain without symmetry
+  // (checked by the caller)
+  if (!foundation.exteriorShading)
+    return;
+
+  for (std::size_t s = 0; s < foundation.surfaces.size() ; s++)
+  {
+    if (foundation.surfaces[s].type == Surface::ST_GRADE
+        || foundation.surfaces[s].type == Surface::ST_WALL_EXT)
+    {
+      for (std::size_t index = 0; index < foundation.surfaces[s].indices.size(); index++)
+      {
+        // Only the local slab (as in setSolarBoundaryConditions)
+        std::size_t i = boost::get<0>(foundation.surfaces[s].indices[index]);
+        if (i < iBegin || i >= iEnd)
+          continue;
+
+        solarI.push_back(i);
+        solarJ.push_back(boost::get<1>(foundation.surfaces[s].indices[index]));
+        solarK.push_back(boost::get<2>(foundation.surfaces[s].indices[index]));
+        solarOrientation.push_back(foundation.surfaces[s].orientation);
+      }
+    }
+  }
+
+  shadingTracer.setSurfaces(foundation.buildingSurfaces);
+}
+
+const std::vector<float>& Ground::getSunlitFractions(double azimuth, double altitude)
+{
+  // Quantize the sun position; fractions are traced toward the center of
+  // each bin and reused for every timestep that falls in it
+  double resolution = foundation.shadingAngularResolution;
+  double aziNorm = fmod(azimuth, 2*PI);
+  if (aziNorm < 0.0)
+    aziNorm += 2*PI;
+  std::pair<int,int> bin(int(floor(aziNorm/resolution)),
+                         int(floor(altitude/resolution)));
+
+  std::map<std::pair<int,int>, std::vector<float>>::iterator it = sunlitFractions.find(bin);
+  if (it != sunlitFractions.end())
+    return it->second;
+
+  std::vector<float>& fractions = sunlitFractions[bin];
+  std::size_t nCells = solarI.size();
+  fractions.assign(nCells, 1.0f);
+
+  if (!shadingTracer.hasSurfaces())
+    return fractions;
+
+  double azi = (bin.first + 0.5)*resolution;
+  double alt = std::min((bin.second + 0.5)*resolution, PI/2);
+  double sun[3] = {cos(alt)*sin(azi - foundation.orientation),
+                   cos(alt)*cos(azi - foundation.orientation),
+                   sin(alt)};
+
+  const int nSamples = foundation.shadingSamples;
+  const double offset = 1e-6;  // [m] off the face, along its outward normal
+  const Mesher* meshes[3] = {&domain.meshX, &domain.meshY, &domain.meshZ};
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (long c = 0; c < long(nCells); c++)
+  {
+    std::size_t i = solarI[c];
+    std::size_t j = solarJ[c];
+    std::size_t k = solarK[c];
+
+    // Face extents: axis a spans u, axis b spans v, normal along axis n
+    std::size_t a, b, n;
+    double normal;
+    switch (solarOrientation[c])
+    {
+    case Surface::X_POS: n = 0; a = 1; b = 2; normal = 1.0; break;
+    case Surface::X_NEG: n = 0; a = 1; b = 2; normal = -1.0; break;
+    case Surface::Y_POS: n = 1; a = 0; b = 2; normal = 1.0; break;
+    case Surface::Y_NEG: n = 1; a = 0; b = 2; normal = -1.0; break;
+    case Surface::Z_NEG: n = 2; a = 0; b = 1; normal = -1.0; break;
+    default: n = 2; a = 0; b = 1; normal = 1.0; break;
+    }
+
+    if (sun[n]*normal <= 0.0)
+    {
+      fractions[c] = 0.0f;
+      continue;
+    }
+
+    std::size_t idx[3] = {i, j, k};
+
+    double origin[3];
+    origin[n] = meshes[n]->centers[idx[n]] + normal*offset;
+    double aMin = meshes[a]->dividers[idx[a]];
+    double aMax = meshes[a]->dividers[idx[a]+1];
+    double bMin = meshes[b]->dividers[idx[b]];
+    double bMax = meshes[b]->dividers[idx[b]+1];
+
+    int sunlit = 0;
+    for (int sa = 0; sa < nSamples; sa++)
+    {
+      origin[a] = aMin + (sa + 0.5)*(aMax - aMin)/nSamples;
+      for (int sb = 0; sb < nSamples; sb++)
+      {
+        origin[b] = bMin + (sb + 0.5)*(bMax - bMin)/nSamples;
+        if (!shadingTracer.isOccluded(origin, sun))
+          sunlit++;
+      }
+    }
+    fractions[c] = float(sunlit)/float(nSamples*nSamples);
+  }
+
+  return fractions;
+}
+
 void Ground::setSolarBoundaryConditions()
 {
+  const std::vector<float>* sunlit = NULL;
+  if (foundation.exteriorShading && bcs.globalHorizontalFlux > 0.0 && sin(bcs.solarAltitude) > 0.0)
+    sunlit = &getSunlitFractions(bcs.solarAzimuth, bcs.solarAltitude);
+  std::size_t solarIndex = 0;
+
   for (std::size_t s = 0; s < foundation.surfaces.size() ; s++)
   {
     if (foundation.surfaces[s].type == Surface::ST_GRADE
@@ -2463,7 +3297,9 @@ void Ground::setSolarBoundaryConditions()
       double rho_g = 1.0 - foundation.soilAbsorptivity;
 
 #if defined(ENABLE_OPENGL)
-      PixelCounter counter(512, 1, false);
+      // Created on first use, so the ray-traced exterior shading (and steps
+      // without direct sun) do not require an OpenGL context
+      std::unique_ptr<PixelCounter> counter;
 #endif
 
       for (std::size_t index = 0; index < foundation.surfaces[s].indices.size(); index++)
@@ -2472,11 +3308,22 @@ void Ground::setSolarBoundaryConditions()
         std::size_t j = boost::get<1>(foundation.surfaces[s].indices[index]);
         std::size_t k = boost::get<2>(foundation.surfaces[s].indices[index]);
 
-        double alpha = domain.cell[i][j][k].surface.absorptivity;
+        // Cells outside of the local slab are calculated by other processes
+        if (i < iBegin || i >= iEnd)
+          continue;
+
+        double alpha = foundation.surfaces[s].absorptivity;
 
         if (qGH > 0.0)
         {
 
+          if (foundation.exteriorShading)
+          {
+            pssf = incidence;
+            if (sunlit)
+              pssf *= (*sunlit)[solarIndex];
+          }
+          else
 #if defined(ENABLE_OPENGL)
           if (isGreaterThan(domain.cell[i][j][k].area, 0.0))
           {
@@ -2499,16 +3346,21 @@ void Ground::setSolarBoundaryConditions()
             poly.outer().push_back(Point3(xMax,yMin,zMin));
             shadedSurface[0] = poly;
 
-            double areaRatio = counter.getAreaRatio(foundation.orientation,azi,alt,foundation.buildingSurfaces,shadedSurface, 0);
+            if (!counter)
+              counter.reset(new PixelCounter(512, 1, false));
 
-            int pixels = counter.retrievePixelCount(0);
+            double areaRatio = counter->getAreaRatio(foundation.orientation,azi,alt,foundation.buildingSurfaces,shadedSurface, 0);
+
+            int pixels = counter->retrievePixelCount(0);
             pssf = areaRatio*pixels;
 
           }
           else
           {
 #else
-          pssf = incidence;
+          {
+            pssf = incidence;
+          }
 #endif
 #if defined(ENABLE_OPENGL)
           }
@@ -2521,6 +3373,7 @@ void Ground::setSolarBoundaryConditions()
           q = 0;
         }
         domain.cell[i][j][k].heatGain = q;
+        solarIndex++;
 
       }
     }
@@ -10,17 +10,26 @@
 #include "Foundation.hpp"
 #include "GroundOutput.hpp"
 #include "Algorithms.hpp"
+#include "RayTracer.hpp"
+#include "PhaseTimer.hpp"
+#include "Tracer.hpp"
 #include "libkiva_export.h"
 
 #include <cmath>
 #include <vector>
 #include <string>
 #include <numeric>
+#include <map>
+#include <utility>
 
 #include <boost/lexical_cast.hpp>
 
 #include "lis.h"
 
+#ifdef ENABLE_MPI
+#include <mpi.h>
+#endif
+
 namespace Kiva {
 
 class LIBKIVA_EXPORT Ground
@@ -40,8 +49,14 @@ public:
 
   size_t nX, nY, nZ;
 
-  std::vector<std::vector<std::vector<double>>> TNew; // solution, n+1
-  std::vector<std::vector<std::vector<double>>> TOld; // solution, n
+  // Time spent building the domain and in each step is added to the timer,
+  // if set
+  PhaseTimer* timer;
+
+  // Temperatures of the stored columns (see distribute); other columns are
+  // empty
+  std::vector<std::vector<std::vector<StorageType>>> TNew; // solution, n+1
+  std::vector<std::vector<std::vector<StorageType>>> TOld; // solution, n
 
   void buildDomain();
 
@@ -50,10 +65,79 @@ public:
   void calculate(BoundaryConditions& boundaryConidtions, double ts=0.0);
 
   std::vector<double> calculateHeatFlux(const size_t &i, const size_t &j, const size_t &k);
+  void calculateHeatFlux(std::size_t i, std::size_t j, std::size_t k,
+                         double &Qx, double &Qy, double &Qz);
+
+  // Heat flux [W/m2] for the block of cells [iMin,iMax]x[jMin,jMax]x[kMin,kMax]
+  // (inclusive) written to caller-provided arrays indexed
+  // (i-iMin) + nI*(j-jMin) + nI*nJ*(k-kMin). Any array may be null. When
+  // the domain is distributed, every process must call this, and the block
+  // is gathered into the arrays of the root process (the arrays of other
+  // processes are not used).
+  void calculateHeatFlux(std::size_t iMin, std::size_t iMax,
+                         std::size_t jMin, std::size_t jMax,
+                         std::size_t kMin, std::size_t kMax,
+                         double *Qx, double *Qy, double *Qz, double *Qmag);
+
+  // Temperatures [K] of the current solution for a block of cells, indexed
+  // and gathered like the heat flux above
+  void getTemperatures(std::size_t iMin, std::size_t iMax,
+                       std::size_t jMin, std::size_t jMax,
+                       std::size_t kMin, std::size_t kMax,
+                       double *T);
 
 
   void calculateSurfaceAverages();
   double getSurfaceAverageValue(std::pair<Surface::SurfaceType, GroundOutput::OutputType> output);
+  double getSurfaceAverageValue(std::size_t outputIndex);  // see GroundOutput::getOutputIndex
+
+  // Ensemble members: additional temperature fields advanced with the same
+  // domain and solver data structures (e.g., for alternate boundary
+  // conditions). Members are initialized to the current solution.
+  std::vector<std::vector<std::vector<std::vector<StorageType>>>> ensembleTNew;
+  std::vector<std::vector<std::vector<std::vector<StorageType>>>> ensembleTOld;
+
+  void setEnsembleSize(std::size_t members);
+  std::size_t getEnsembleSize();
+
+  // Advances each ensemble member (and then the main solution, using the last
+  // element of boundaryConditions, which must hold one element per member
+  // plus one). Surface averages are calculated for each
+  // ensemble member. With the implicit schemes, members share the assembled
+  // interior rows of the matrix, so only boundary rows and the right-hand
+  // side are calculated for each member.
+  void calculateEnsemble(std::vector<BoundaryConditions>& boundaryConditions, double ts=0.0);
+  double getEnsembleSurfaceAverageValue(std::size_t member, std::pair<Surface::SurfaceType, GroundOutput::OutputType> output);
+  double getEnsembleSurfaceAverageValue(std::size_t member, std::size_t outputIndex);
+
+  // Initial guess of the iterative solvers (the previous solution, ordered
+  // i + nX*j + nX*nY*k) of the main solution or an ensemble member, e.g., to
+  // save and restore the complete state of a simulation. Empty when the
+  // domain is distributed, since the iterative solvers are not used.
+  std::vector<double> getSolverGuess(long member = -1);
+  void setSolverGuess(const std::vector<double> &values, long member = -1);
+
+  // Distributed calculation: each process stores and calculates a slab of
+  // cells [iBegin, iEnd) in the x-direction, and also stores the columns
+  // [iStoredBegin, iBegin) and [iEnd, iStoredEnd) of the neighboring slabs,
+  // which are exchanged after each timestep. Only the explicit scheme is
+  // calculated on a distributed domain. (Without distribute, or with a
+  // single process, one process stores and calculates all columns.)
+  std::size_t iBegin, iEnd;
+  std::size_t iStoredBegin, iStoredEnd;
+#ifdef ENABLE_MPI
+  // Called before buildDomain. Returns false if the numerical scheme cannot
+  // be calculated on a distributed domain.
+  bool distribute(MPI_Comm communicator);
+#endif
+  bool isDistributed();
+
+  // Gathers a temperature field (e.g., TOld, or TNew of an ensemble member)
+  // of the whole domain, ordered k + nZ*j + nZ*nY*i so that the columns of
+  // each process are contiguous. When the domain is distributed, every
+  // process must call this, and only the root process receives the field
+  // (others receive an empty vector).
+  std::vector<double> gatherField(const std::vector<std::vector<std::vector<StorageType>>> &T);
 
 
 private:
@@ -64,10 +148,10 @@ private:
   // Data structures
 
   // ADE
-  std::vector<std::vector<std::vector<double>>> U; // ADE upper sweep, n+1
-  std::vector<std::vector<std::vector<double>>> UOld; // ADE upper sweep, n
-  std::vector<std::vector<std::vector<double>>> V; // ADE lower sweep, n+1
-  std::vector<std::vector<std::vector<double>>> VOld; // ADE lower sweep, n
+  std::vector<std::vector<std::vector<StorageType>>> U; // ADE upper sweep, n+1
+  std::vector<std::vector<std::vector<StorageType>>> UOld; // ADE upper sweep, n
+  std::vector<std::vector<std::vector<StorageType>>> V; // ADE lower sweep, n+1
+  std::vector<std::vector<std::vector<StorageType>>> VOld; // ADE lower sweep, n
 
   // ADI
   std::vector<double> a1; // lower diagonal
@@ -82,6 +166,72 @@ private:
 
   LIS_SOLVER solver;
 
+  // Matrix of the implicit schemes in compressed sparse row form, copied to
+  // Amat for each solution. Its structure is built by the first solution.
+  // Rows of interior cells depend only on the scheme and timestep, so they
+  // are only rewritten when either changes; boundary rows are rewritten for
+  // each solution (e.g., each ensemble member).
+  std::vector<std::vector<std::pair<LIS_INT,double>>> matrixRows;  // while building
+  std::vector<LIS_INT> csrPtr, csrIndex;
+  std::vector<double> csrValue;
+  bool matrixInteriorCurrent;
+  Foundation::NumericalScheme matrixScheme;
+  double matrixTimestep;
+
+  // Distributed calculation
+  bool distributed;
+#ifdef ENABLE_MPI
+  MPI_Comm comm;
+  int rank, nProcs;
+  std::vector<std::size_t> slabBegin;  // first x-index of each process (plus nX)
+  void exchangeHalos();
+
+  // Gathers the values of a block's columns [iMin, iMax] calculated by each
+  // process for the columns it owns (indexed like the block) into the
+  // block's values on the root process
+  void gatherBlock(std::size_t iMin, std::size_t iMax, std::size_t nJK,
+                   const std::vector<double> &local, double *values);
+#endif
+
+  // Ensemble
+  std::vector<LIS_VECTOR> ensembleX;
+  std::vector<std::vector<double>> ensembleOutputValues;
+
+  // Surface averages: the local boundary cells of each surface type in
+  // GroundOutput::outputMap (in map order), gathered once after the domain
+  // is built
+  struct SurfaceAveragePlan
+  {
+    double constructionRValue;
+    double surfaceArea;
+    std::vector<std::size_t> i, j, k;
+    std::vector<double> area, emissivity, tilt;
+    std::vector<double> T, hc, hr;  // per-step values
+  };
+  std::vector<SurfaceAveragePlan> surfaceAveragePlans;
+  void compileSurfaceAverages();
+
+  // Convection and radiation coefficients of the local INTERIOR_FLUX (first
+  // nInteriorBoundaryCells) and EXTERIOR_FLUX boundary cells, indexed by
+  // Cell::boundaryIndex and evaluated together from TOld before each pass of
+  // the numerical scheme
+  std::size_t nInteriorBoundaryCells;
+  std::vector<std::size_t> boundaryI, boundaryJ, boundaryK;
+  std::vector<double> boundaryTilt, boundaryEmissivity, boundaryT;
+  std::vector<double> boundaryHc, boundaryHr;
+  void compileBoundaryCells();
+  void calculateBoundaryCoefficients();
+
+  // Exterior shading by the building surfaces: sunlit fractions of the local
+  // solar boundary cells (ST_GRADE and ST_WALL_EXT, in surface order), ray traced
+  // once per quantized sun position
+  RayTracer shadingTracer;
+  std::vector<std::size_t> solarI, solarJ, solarK;
+  std::vector<Surface::Orientation> solarOrientation;
+  std::map<std::pair<int,int>, std::vector<float>> sunlitFractions;
+  void compileShading();
+  const std::vector<float>& getSunlitFractions(double azimuth, double altitude);
+
   std::vector<char> solverOptions;
 
 private:
@@ -99,6 +249,11 @@ private:
 
   void calculateADI(int dim);
 
+  void calculateLocalHeatFlux(std::size_t iMin, std::size_t iMax,
+                              std::size_t jMin, std::size_t jMax,
+                              std::size_t kMin, std::size_t kMax,
+                              double *Qx, double *Qy, double *Qz, double *Qmag);
+
   // Misc. Functions
   void setAmatValue(const int i, const int j, const double val);
   void setbValue(const int i, const double val);
@@ -106,14 +261,6 @@ private:
   void clearAmat();
   double getxValue(const int i);
 
-  double getConvectionCoeff(double Tsurf,
-                double Tamb,
-                double Vair,
-                double roughness,
-                bool isExterior,
-                double tilt);
-
-
   double getSurfaceArea(Surface::SurfaceType surfaceType);
 
   void setSolarBoundaryConditions();
@@ -6,6 +6,8 @@
 
 #include "Foundation.hpp"
 
+#include <cassert>
+
 namespace Kiva {
 
 class GroundOutput {
@@ -20,17 +22,36 @@ public:
     OT_RATE
   };
 
+  static const std::size_t numberOfOutputTypes = 4;
+
   typedef std::map<Surface::SurfaceType, std::vector<OutputType>> OutputMap;
 
   GroundOutput(OutputMap oM) {
     outputMap = oM;
+
+    std::size_t slot = 0;
+    for (auto output : outputMap)
+      surfaceSlots[output.first] = slot++;
+
+    outputValues.resize(slot*numberOfOutputTypes);
   };
 
   GroundOutput() {};
 
   OutputMap outputMap;
 
-  std::map<std::pair<Surface::SurfaceType, OutputType>,double> outputValues;
+  // Every output type is calculated for each surface in outputMap. Values are
+  // stored densely by output index (see getOutputIndex).
+  std::vector<double> outputValues;
+
+  // The surface must be in outputMap
+  std::size_t getOutputIndex(Surface::SurfaceType surface, OutputType outputType) {
+    assert(surfaceSlots.count(surface));
+    return surfaceSlots[surface]*numberOfOutputTypes + outputType;
+  };
+
+  // Position of each surface type in outputMap
+  std::map<Surface::SurfaceType, std::size_t> surfaceSlots;
 
 };
 
@@ -0,0 +1,240 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#include "PhaseTimer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace Kiva {
+
+static const char* phaseNames[PhaseTimer::N_PHASES] = {
+  "Input",
+  "Weather",
+  "Mesh",
+  "Domain",
+  "Boundary layer",
+  "Steady state",
+  "Acceleration",
+  "Warmup",
+  "Boundary conditions",
+  "Solve",
+  "Surface averages",
+  "Plot",
+  "Output",
+  "Step"
+};
+
+// Keys of the JSON report
+static const char* phaseKeys[PhaseTimer::N_PHASES] = {
+  "input",
+  "weather",
+  "mesh",
+  "domain",
+  "boundary_layer",
+  "steady_state",
+  "acceleration",
+  "warmup",
+  "boundary_conditions",
+  "solve",
+  "surface_averages",
+  "plot",
+  "output",
+  "step"
+};
+
+static const double percentiles[] = {50.0, 90.0, 99.0};
+
+PhaseTimer::PhaseTimer() : created(Clock::now()), inStep(false), cellUpdates(0)
+{
+  for (std::size_t p = 0; p < N_PHASES; p++)
+  {
+    totals[p] = 0.0;
+    counts[p] = 0;
+    stepStart[p] = 0.0;
+  }
+}
+
+void PhaseTimer::start(Phase phase)
+{
+  if (isStepPhase(phase) && !inStep)
+    return;
+  started[phase] = Clock::now();
+}
+
+void PhaseTimer::stop(Phase phase)
+{
+  if (isStepPhase(phase) && !inStep)
+    return;
+  totals[phase] += std::chrono::duration<double>(Clock::now() - started[phase]).count();
+  counts[phase]++;
+}
+
+void PhaseTimer::beginStep()
+{
+  inStep = true;
+  for (std::size_t p = 0; p < N_PHASES; p++)
+    stepStart[p] = totals[p];
+  start(PH_STEP);
+}
+
+void PhaseTimer::endStep()
+{
+  stop(PH_STEP);
+  for (std::size_t p = 0; p < N_PHASES; p++)
+  {
+    if (isStepPhase(Phase(p)))
+      stepTimes[p].push_back(totals[p] - stepStart[p]);
+  }
+  inStep = false;
+}
+
+void PhaseTimer::addCellUpdates(std::size_t cells)
+{
+  if (inStep)
+    cellUpdates += cells;
+}
+
+double PhaseTimer::getTotal(Phase phase) const
+{
+  return totals[phase];
+}
+
+std::size_t PhaseTimer::getCount(Phase phase) const
+{
+  return counts[phase];
+}
+
+double PhaseTimer::getElapsed() const
+{
+  return std::chrono::duration<double>(Clock::now() - created).count();
+}
+
+std::size_t PhaseTimer::getSteps() const
+{
+  return stepTimes[PH_STEP].size();
+}
+
+double PhaseTimer::getStepPercentile(Phase phase, double p) const
+{
+  std::vector<double> times = stepTimes[phase];
+  if (times.empty())
+    return 0.0;
+
+  // Nearest rank
+  std::size_t rank = std::size_t(std::ceil(p/100.0*times.size()));
+  std::size_t n = rank > 0 ? rank - 1 : 0;
+  n = std::min(n, times.size() - 1);
+  std::nth_element(times.begin(), times.begin() + n, times.end());
+  return times[n];
+}
+
+const char* PhaseTimer::getName(Phase phase)
+{
+  return phaseNames[phase];
+}
+
+bool PhaseTimer::isStepPhase(Phase phase)
+{
+  return phase >= PH_BOUNDARY_CONDITIONS;
+}
+
+void PhaseTimer::writeReport(std::ostream &out) const
+{
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed;
+
+  out << "Timing Report:\n";
+
+  const char* groups[] = {"Setup", "Initialization"};
+  Phase groupEnds[] = {PH_STEADY_STATE, PH_BOUNDARY_CONDITIONS};
+  std::size_t p = 0;
+  for (std::size_t g = 0; g < 2; g++)
+  {
+    out << "  " << groups[g] << ":" << std::setw(34 - std::string(groups[g]).size()) << "[s]" << "\n";
+    for (; p < std::size_t(groupEnds[g]); p++)
+      out << "    " << std::left << std::setw(21) << phaseNames[p] << std::right
+          << std::setw(12) << std::setprecision(3) << totals[p] << "\n";
+  }
+
+  std::size_t steps = getSteps();
+  out << "  Simulation (" << steps << " steps):\n";
+  out << "    " << std::setw(33) << "total [s]"
+      << std::setw(12) << "mean [ms]"
+      << std::setw(12) << "p50 [ms]"
+      << std::setw(12) << "p90 [ms]"
+      << std::setw(12) << "p99 [ms]"
+      << std::setw(12) << "max [ms]" << "\n";
+  for (; p < N_PHASES; p++)
+  {
+    Phase phase = Phase(p);
+    out << "    " << std::left << std::setw(21) << phaseNames[p] << std::right
+        << std::setw(12) << std::setprecision(3) << totals[p]
+        << std::setprecision(4)
+        << std::setw(12) << (steps > 0 ? 1000.0*totals[p]/steps : 0.0);
+    for (std::size_t i = 0; i < 3; i++)
+      out << std::setw(12) << 1000.0*getStepPercentile(phase, percentiles[i]);
+    out << std::setw(12) << 1000.0*getStepPercentile(phase, 100.0) << "\n";
+  }
+
+  double stepTime = totals[PH_STEP];
+  out << "  Cell Updates: " << cellUpdates;
+  if (stepTime > 0.0)
+    out << " (" << std::scientific << std::setprecision(3) << cellUpdates/stepTime
+        << " per second)";
+  out << "\n";
+  out << "  Elapsed Time: " << std::fixed << std::setprecision(3) << getElapsed() << " s" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void PhaseTimer::writeJSON(std::ostream &out, const std::string &version) const
+{
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::setprecision(9);
+
+  double stepTime = totals[PH_STEP];
+  double solveTime = totals[PH_SOLVE];
+
+  out << "{\n";
+  out << "  \"version\": \"";
+  for (std::size_t c = 0; c < version.size(); c++)
+  {
+    if (version[c] == '"' || version[c] == '\\')
+      out << '\\';
+    out << version[c];
+  }
+  out << "\",\n";
+  out << "  \"elapsed\": " << getElapsed() << ",\n";
+  out << "  \"steps\": " << getSteps() << ",\n";
+  out << "  \"cell_updates\": " << cellUpdates << ",\n";
+  out << "  \"cell_updates_per_second\": " << (stepTime > 0.0 ? cellUpdates/stepTime : 0.0) << ",\n";
+  out << "  \"cell_updates_per_solve_second\": " << (solveTime > 0.0 ? cellUpdates/solveTime : 0.0) << ",\n";
+  out << "  \"phases\": {\n";
+  for (std::size_t p = 0; p < N_PHASES; p++)
+  {
+    Phase phase = Phase(p);
+    out << "    \"" << phaseKeys[p] << "\": {\"total\": " << totals[p]
+        << ", \"count\": " << counts[p];
+    if (isStepPhase(phase))
+    {
+      std::size_t steps = getSteps();
+      out << ", \"mean\": " << (steps > 0 ? totals[p]/steps : 0.0);
+      for (std::size_t i = 0; i < 3; i++)
+        out << ", \"p" << percentiles[i] << "\": " << getStepPercentile(phase, percentiles[i]);
+      out << ", \"max\": " << getStepPercentile(phase, 100.0);
+    }
+    out << "}" << (p + 1 < N_PHASES ? "," : "") << "\n";
+  }
+  out << "  }\n";
+  out << "}" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+}
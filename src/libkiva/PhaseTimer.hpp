@@ -0,0 +1,108 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef PHASETIMER_HPP_
+#define PHASETIMER_HPP_
+
+#include "libkiva_export.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Kiva {
+
+// Wall-clock time spent in each phase of a run (on the calling thread).
+// Per-step phases are only accumulated between beginStep and endStep, which
+// also keeps the time of each per-step phase for every step.
+class LIBKIVA_EXPORT PhaseTimer
+{
+public:
+
+  enum Phase
+  {
+    // Setup
+    PH_INPUT,
+    PH_WEATHER,
+    PH_MESH,
+    PH_DOMAIN,
+    PH_BOUNDARY_LAYER,
+    // Initialization
+    PH_STEADY_STATE,
+    PH_ACCELERATION,
+    PH_WARMUP,
+    // Per step
+    PH_BOUNDARY_CONDITIONS,
+    PH_SOLVE,
+    PH_SURFACE_AVERAGES,
+    PH_PLOT,
+    PH_OUTPUT,
+    PH_STEP,  // complete step
+    N_PHASES
+  };
+
+  PhaseTimer();
+
+  void start(Phase phase);
+  void stop(Phase phase);
+
+  void beginStep();
+  void endStep();
+
+  // Cells calculated by the numerical scheme (counted during steps only)
+  void addCellUpdates(std::size_t cells);
+
+  double getTotal(Phase phase) const;  // [s]
+  std::size_t getCount(Phase phase) const;
+  double getElapsed() const;  // [s] since construction
+  std::size_t getSteps() const;
+
+  // Time of the per-step phase at percentile p [0-100] of all steps [s]
+  double getStepPercentile(Phase phase, double p) const;
+
+  static const char* getName(Phase phase);
+  static bool isStepPhase(Phase phase);
+
+  void writeReport(std::ostream &out) const;
+  void writeJSON(std::ostream &out, const std::string &version) const;
+
+  // Times a phase for the lifetime of the scope (nothing if timer is null)
+  class Scope
+  {
+  public:
+    Scope(PhaseTimer* timer, Phase phase) : timer(timer), phase(phase)
+    {
+      if (timer)
+        timer->start(phase);
+    }
+    ~Scope()
+    {
+      if (timer)
+        timer->stop(phase);
+    }
+  private:
+    PhaseTimer* timer;
+    Phase phase;
+  };
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  Clock::time_point created;
+  Clock::time_point started[N_PHASES];
+  double totals[N_PHASES];
+  std::size_t counts[N_PHASES];
+
+  bool inStep;
+  double stepStart[N_PHASES];  // totals at the beginning of the current step
+  std::vector<double> stepTimes[N_PHASES];
+
+  unsigned long long cellUpdates;
+
+};
+
+}
+
+#endif /* PHASETIMER_HPP_ */
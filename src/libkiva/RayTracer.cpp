@@ -0,0 +1,215 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef RAYTRACER_CPP_
+#define RAYTRACER_CPP_
+
+#include "RayTracer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Kiva {
+
+static const std::size_t maxLeafSize = 4;
+static const std::size_t maxDepth = 64;
+
+void RayTracer::setSurfaces(const std::vector<Polygon3> &surfaces)
+{
+  triangles.clear();
+  nodes.clear();
+
+  // Fan triangulation of each (convex) polygon
+  for (std::size_t p = 0; p < surfaces.size(); p++)
+  {
+    const Polygon3::ring_type &ring = surfaces[p].outer();
+    for (std::size_t v = 1; v + 1 < ring.size(); v++)
+    {
+      const Point3 *points[3] = {&ring[0], &ring[v], &ring[v+1]};
+      double x[3][3];
+      for (std::size_t n = 0; n < 3; n++)
+      {
+        x[n][0] = points[n]->get<0>();
+        x[n][1] = points[n]->get<1>();
+        x[n][2] = points[n]->get<2>();
+      }
+
+      Triangle tri;
+      for (std::size_t d = 0; d < 3; d++)
+      {
+        tri.v0[d] = x[0][d];
+        tri.e1[d] = x[1][d] - x[0][d];
+        tri.e2[d] = x[2][d] - x[0][d];
+        tri.lo[d] = std::min(x[0][d],std::min(x[1][d],x[2][d]));
+        tri.hi[d] = std::max(x[0][d],std::max(x[1][d],x[2][d]));
+        tri.centroid[d] = (x[0][d] + x[1][d] + x[2][d])/3.0;
+      }
+      triangles.push_back(tri);
+    }
+  }
+
+  if (!triangles.empty())
+  {
+    nodes.reserve(2*triangles.size());
+    build(0, triangles.size());
+  }
+}
+
+bool RayTracer::hasSurfaces() const
+{
+  return !triangles.empty();
+}
+
+std::size_t RayTracer::build(std::size_t first, std::size_t count)
+{
+  std::size_t index = nodes.size();
+  nodes.push_back(Node());
+
+  double lo[3], hi[3], cLo[3], cHi[3];
+  for (std::size_t d = 0; d < 3; d++)
+  {
+    lo[d] = cLo[d] = std::numeric_limits<double>::max();
+    hi[d] = cHi[d] = -std::numeric_limits<double>::max();
+  }
+  for (std::size_t t = first; t < first + count; t++)
+  {
+    for (std::size_t d = 0; d < 3; d++)
+    {
+      lo[d] = std::min(lo[d], triangles[t].lo[d]);
+      hi[d] = std::max(hi[d], triangles[t].hi[d]);
+      cLo[d] = std::min(cLo[d], triangles[t].centroid[d]);
+      cHi[d] = std::max(cHi[d], triangles[t].centroid[d]);
+    }
+  }
+
+  Node node;
+  for (std::size_t d = 0; d < 3; d++)
+  {
+    node.lo[d] = lo[d];
+    node.hi[d] = hi[d];
+  }
+  node.first = first;
+  node.count = count;
+  node.left = node.right = 0;
+
+  if (count > maxLeafSize)
+  {
+    // Median split along the longest extent of the centroids
+    std::size_t axis = 0;
+    for (std::size_t d = 1; d < 3; d++)
+    {
+      if (cHi[d] - cLo[d] > cHi[axis] - cLo[axis])
+        axis = d;
+    }
+
+    if (cHi[axis] > cLo[axis])
+    {
+      std::size_t half = count/2;
+      std::nth_element(triangles.begin() + first,
+                       triangles.begin() + first + half,
+                       triangles.begin() + first + count,
+                       [axis](const Triangle &a, const Triangle &b)
+                       {return a.centroid[axis] < b.centroid[axis];});
+
+      node.count = 0;
+      node.left = build(first, half);
+      node.right = build(first + half, count - half);
+    }
+  }
+
+  nodes[index] = node;
+  return index;
+}
+
+bool RayTracer::isOccluded(const double origin[3], const double direction[3]) const
+{
+  if (nodes.empty())
+    return false;
+
+  double invDirection[3];
+  for (std::size_t d = 0; d < 3; d++)
+    invDirection[d] = 1.0/direction[d];
+
+  const double tMin = 1e-9;
+  const double epsilon = 1e-12;
+
+  std::size_t stack[maxDepth];
+  std::size_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const Node &node = nodes[stack[--top]];
+
+    // Slab test against the node bounding box
+    double tNear = 0.0;
+    double tFar = std::numeric_limits<double>::max();
+    bool miss = false;
+    for (std::size_t d = 0; d < 3; d++)
+    {
+      if (direction[d] == 0.0)
+      {
+        if (origin[d] < node.lo[d] || origin[d] > node.hi[d])
+        {
+          miss = true;
+          break;
+        }
+        continue;
+      }
+      double t1 = (node.lo[d] - origin[d])*invDirection[d];
+      double t2 = (node.hi[d] - origin[d])*invDirection[d];
+      tNear = std::max(tNear, std::min(t1, t2));
+      tFar = std::min(tFar, std::max(t1, t2));
+      if (tNear > tFar)
+      {
+        miss = true;
+        break;
+      }
+    }
+    if (miss)
+      continue;
+
+    if (node.count > 0)
+    {
+      // Moller-Trumbore intersection with each triangle in the leaf
+      for (std::size_t t = node.first; t < node.first + node.count; t++)
+      {
+        const Triangle &tri = triangles[t];
+        double p[3] = {direction[1]*tri.e2[2] - direction[2]*tri.e2[1],
+                       direction[2]*tri.e2[0] - direction[0]*tri.e2[2],
+                       direction[0]*tri.e2[1] - direction[1]*tri.e2[0]};
+        double det = tri.e1[0]*p[0] + tri.e1[1]*p[1] + tri.e1[2]*p[2];
+        if (std::fabs(det) < epsilon)
+          continue;
+        double invDet = 1.0/det;
+        double s[3] = {origin[0] - tri.v0[0],
+                       origin[1] - tri.v0[1],
+                       origin[2] - tri.v0[2]};
+        double u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*invDet;
+        if (u < 0.0 || u > 1.0)
+          continue;
+        double q[3] = {s[1]*tri.e1[2] - s[2]*tri.e1[1],
+                       s[2]*tri.e1[0] - s[0]*tri.e1[2],
+                       s[0]*tri.e1[1] - s[1]*tri.e1[0]};
+        double v = (direction[0]*q[0] + direction[1]*q[1] + direction[2]*q[2])*invDet;
+        if (v < 0.0 || u + v > 1.0)
+          continue;
+        double tHit = (tri.e2[0]*q[0] + tri.e2[1]*q[1] + tri.e2[2]*q[2])*invDet;
+        if (tHit > tMin)
+          return true;
+      }
+    }
+    else
+    {
+      stack[top++] = node.left;
+      stack[top++] = node.right;
+    }
+  }
+
+  return false;
+}
+
+}
+
+#endif
@@ -0,0 +1,51 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef RAYTRACER_HPP_
+#define RAYTRACER_HPP_
+
+#include "Geometry.hpp"
+
+#include <vector>
+
+namespace Kiva {
+
+// Occlusion tests of rays against a set of planar (convex) polygons, held as
+// triangles in a bounding volume hierarchy
+class RayTracer
+{
+public:
+
+  void setSurfaces(const std::vector<Polygon3> &surfaces);
+
+  bool hasSurfaces() const;
+
+  // true if the ray from origin along direction hits any surface
+  bool isOccluded(const double origin[3], const double direction[3]) const;
+
+private:
+
+  struct Triangle
+  {
+    double v0[3], e1[3], e2[3];
+    double lo[3], hi[3];
+    double centroid[3];
+  };
+
+  struct Node
+  {
+    double lo[3], hi[3];
+    std::size_t first, count;  // triangle range (leaf nodes)
+    std::size_t left, right;  // child nodes (interior nodes, count == 0)
+  };
+
+  std::vector<Triangle> triangles;
+  std::vector<Node> nodes;
+
+  std::size_t build(std::size_t first, std::size_t count);
+
+};
+
+}
+
+#endif /* RAYTRACER_HPP_ */
@@ -0,0 +1,176 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#include "Tracer.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+#ifdef HAVE_STD_THREAD
+#include <mutex>
+#endif
+
+// Visual Studio 2013 has no thread_local (__declspec(thread) is equivalent
+// for the pointers and flags used here)
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define TRACER_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACER_THREAD_LOCAL thread_local
+#endif
+
+namespace Kiva {
+
+typedef std::chrono::steady_clock Clock;
+
+struct TraceEvent
+{
+  const char* name;
+  Clock::time_point time;
+  char phase;  // 'B' (begin) or 'E' (end)
+};
+
+struct TraceBuffer
+{
+  std::size_t threadId;
+  std::string threadName;
+  std::vector<TraceEvent> events;
+};
+
+std::atomic<bool> Tracer::enabled(false);
+
+static Clock::time_point traceStart;
+
+// Buffers of every thread that has recorded events (kept after the thread
+// exits)
+static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+static TRACER_THREAD_LOCAL TraceBuffer* threadBuffer = NULL;
+
+#ifdef HAVE_STD_THREAD
+
+static std::mutex buffersMutex;
+
+static TraceBuffer* getThreadBuffer()
+{
+  if (!threadBuffer)
+  {
+    std::unique_lock<std::mutex> lock(buffersMutex);
+    buffers.emplace_back(new TraceBuffer());
+    threadBuffer = buffers.back().get();
+    threadBuffer->threadId = buffers.size();
+    threadBuffer->events.reserve(4096);
+  }
+  return threadBuffer;
+}
+
+void Tracer::enable()
+{
+  traceStart = Clock::now();
+  enabled.store(true);
+}
+
+#else
+
+// Without standard library threads, buffers cannot be registered safely from
+// other threads (e.g., OpenMP), so only the thread that enabled the tracer
+// records events
+
+static TraceBuffer* getThreadBuffer()
+{
+  return threadBuffer;
+}
+
+void Tracer::enable()
+{
+  buffers.emplace_back(new TraceBuffer());
+  threadBuffer = buffers.back().get();
+  threadBuffer->threadId = 1;
+  traceStart = Clock::now();
+  enabled.store(true);
+}
+
+#endif
+
+void Tracer::begin(const char* name)
+{
+  TraceBuffer* buffer = getThreadBuffer();
+  if (!buffer)
+    return;
+  TraceEvent event = {name, Clock::now(), 'B'};
+  buffer->events.push_back(event);
+}
+
+void Tracer::end(const char* name)
+{
+  TraceBuffer* buffer = getThreadBuffer();
+  if (!buffer)
+    return;
+  TraceEvent event = {name, Clock::now(), 'E'};
+  buffer->events.push_back(event);
+}
+
+void Tracer::setThreadName(const std::string &name)
+{
+  TraceBuffer* buffer = isEnabled() ? getThreadBuffer() : NULL;
+  if (buffer)
+    buffer->threadName = name;
+}
+
+static void writeString(std::ostream &out, const std::string &s)
+{
+  out << '"';
+  for (std::size_t c = 0; c < s.size(); c++)
+  {
+    if (s[c] == '"' || s[c] == '\\')
+      out << '\\';
+    out << s[c];
+  }
+  out << '"';
+}
+
+void Tracer::write(std::ostream &out)
+{
+#ifdef HAVE_STD_THREAD
+  std::unique_lock<std::mutex> lock(buffersMutex);
+#endif
+
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  for (std::size_t b = 0; b < buffers.size(); b++)
+  {
+    const TraceBuffer &buffer = *buffers[b];
+
+    if (!buffer.threadName.empty())
+    {
+      out << (first ? "" : ",\n")
+          << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+          << buffer.threadId << ", \"args\": {\"name\": ";
+      writeString(out, buffer.threadName);
+      out << "}}";
+      first = false;
+    }
+
+    for (std::size_t e = 0; e < buffer.events.size(); e++)
+    {
+      const TraceEvent &event = buffer.events[e];
+      out << (first ? "" : ",\n") << "{\"name\": ";
+      writeString(out, event.name);
+      out << ", \"ph\": \"" << event.phase << "\", \"ts\": "
+          << std::chrono::duration<double, std::micro>(event.time - traceStart).count()
+          << ", \"pid\": 1, \"tid\": " << buffer.threadId << "}";
+      first = false;
+    }
+  }
+  out << "\n]}" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+}
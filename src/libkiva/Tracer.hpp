@@ -0,0 +1,70 @@
+/* Copyright (c) 2012-2016 Big Ladder Software. All rights reserved.
+* See the LICENSE file for additional terms and conditions. */
+
+#ifndef TRACER_HPP_
+#define TRACER_HPP_
+
+#include "libkiva_export.h"
+
+#include <atomic>
+#include <ostream>
+#include <string>
+
+namespace Kiva {
+
+// Timeline of begin and end events on each thread, written in the Chrome
+// trace event format (viewed with chrome://tracing or Perfetto). Nothing is
+// recorded until the tracer is enabled. Each thread records into its own
+// buffer, so recording takes no locks (other than once per thread to
+// register its buffer). Without standard library threads (HAVE_STD_THREAD),
+// only the thread that enabled the tracer records events. Event names must
+// be string literals.
+class LIBKIVA_EXPORT Tracer
+{
+public:
+
+  static void enable();
+  static bool isEnabled()
+  {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  static void begin(const char* name);
+  static void end(const char* name);
+
+  // Name shown for the calling thread
+  static void setThreadName(const std::string &name);
+
+  // Writes all recorded events. Threads must not record events while the
+  // trace is being written.
+  static void write(std::ostream &out);
+
+  // Traces the lifetime of the scope
+  class Scope
+  {
+  public:
+    Scope(const char* name) : name(name)
+    {
+      if (isEnabled())
+        begin(name);
+      else
+        this->name = NULL;
+    }
+    ~Scope()
+    {
+      if (name)
+        end(name);
+    }
+  private:
+    const char* name;
+  };
+
+private:
+
+  static std::atomic<bool> enabled;
+
+};
+
+}
+
+#endif /* TRACER_HPP_ */